@@ -0,0 +1,109 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+--- attack module for luachess
+module "chess.attack"
+
+--- Layout of the slider lookup tables, chosen with the MAGIC_LAYOUT cmake
+-- option: <tt>minimized</tt>, <tt>plain</tt>, <tt>perfect</tt> or
+-- <tt>pext</tt>.
+_MAGIC = "minimized"
+
+--- Size of the slider lookup tables in bytes.
+_MAGIC_SIZE = 861184
+
+--- Number of times the lookup tables were built, they're shared by every Lua
+-- state of the process and by chess.board so this is always 1.
+_INITS = 1
+
+--- Light userdata pointing to the lookup tables, the same in chess.board.
+_TABLES = nil
+
+--- Get the attacks of a piece on a square.
+-- @param piece the piece, one of PAWN to KING.
+-- @param square the square, 0 to 63.
+-- @param side the side, needed for pawns.
+-- @param occupancy bitboard of occupied squares, needed for sliders.
+-- @return bitboard of attacked squares.
+function atak(piece, square, side, occupancy) end
+
+--- Get the pieces attacking a square.
+-- @param board board userdata or a chess.Board.
+-- @param square the square, 0 to 63.
+-- @param side the attacking side, if nil pieces of both sides are returned.
+-- @return bitboard of attackers.
+function attackers_to(board, square, side) end
+
+--- Get the squares attacked by a side.
+-- @param board board userdata or a chess.Board.
+-- @param side the attacking side.
+-- @return bitboard of attacked squares.
+function attacked_by(board, side) end
+
+--- Static exchange evaluation of a move.
+-- Captures on the target square are played out, least valuable attacker
+-- first, including the attackers revealed behind the pieces taking part.
+-- @param board board userdata or a chess.Board.
+-- @param move the move, the capture, promotion and en passant bits are used.
+-- @return the material balance for the moving side, a pawn being 100.
+function see(board, move) end
+
+--- Directions of the rays, NORTH is towards the eighth rank and the values
+-- go clockwise so that (dir + 4) % 8 is the opposite direction.
+-- NORTH = 0, NORTHEAST = 1, EAST = 2, SOUTHEAST = 3, SOUTH = 4,
+-- SOUTHWEST = 5, WEST = 6, NORTHWEST = 7
+NORTH = 0
+
+--- Get the squares strictly between two squares.
+-- @param a the first square.
+-- @param b the second square.
+-- @return bitboard, empty if the squares aren't on the same rank, file or
+-- diagonal.
+function between(a, b) end
+
+--- Get the whole line through two squares, both included.
+-- @param a the first square.
+-- @param b the second square.
+-- @return bitboard, empty if the squares aren't on the same rank, file or
+-- diagonal.
+function line(a, b) end
+
+--- Get the squares from a square to the edge of the board.
+-- @param square the square, it isn't included.
+-- @param direction one of the directions above.
+-- @return bitboard
+function ray(square, direction) end
+
+--- Get the Chebyshev distance, the number of king moves between two squares.
+function distance(a, b) end
+
+--- Get the Manhattan distance, the number of rank and file steps between two
+-- squares.
+function manhattan(a, b) end
+
+--- Get the rank of a square as a bitboard.
+function rank_mask(square) end
+
+--- Get the file of a square as a bitboard.
+function file_mask(square) end
+
+--- Get the a1-h8 direction diagonal of a square as a bitboard.
+function diagonal_mask(square) end
+
+--- Get the h1-a8 direction diagonal of a square as a bitboard.
+function antidiagonal_mask(square) end
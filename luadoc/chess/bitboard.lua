@@ -31,6 +31,46 @@ module "chess.bitboard"
 -- the function returns nil and error message.
 function bb(n, base) end
 
+--- Create a packed bitboard array.<br />
+-- The array stores n bitboards contiguously in one userdata. It has the
+-- methods <tt>get(i, out)</tt>, <tt>set(i, x)</tt>, <tt>fill(x)</tt>,
+-- <tt>copy()</tt>, the lane-wise in place operations <tt>ior(other)</tt>,
+-- <tt>iand(other)</tt> and <tt>ixor(other)</tt> which take an array of the
+-- same size, <tt>popcount()</tt> which counts the bits of all the
+-- bitboards and <tt>union()</tt>. <tt>#a</tt> gives the size, indexes
+-- start from 1.
+-- @param n number of bitboards.
+-- @return bitboard array userdata with every bitboard set to 0.
+-- @see _ARRAY_SIMD
+function array(n) end
+
+--- The vector instructions used by bitboard arrays, one of "avx2", "sse2"
+-- or "none".
+_ARRAY_SIMD = "sse2"
+
+--- Compute a &amp; ~b.
+-- @param a bitboard userdata.
+-- @param b bitboard userdata.
+-- @param out bitboard userdata to store the result, optional.
+-- @return out or a new bitboard userdata if out is omitted.
+function and_not(a, b, out) end
+
+--- Compute (a | b) &amp; c.
+-- @param a bitboard userdata.
+-- @param b bitboard userdata.
+-- @param c bitboard userdata.
+-- @param out bitboard userdata to store the result, optional.
+-- @return out or a new bitboard userdata if out is omitted.
+function or_and(a, b, c, out) end
+
+--- Compute a &amp; b &amp; c.
+-- @param a bitboard userdata.
+-- @param b bitboard userdata.
+-- @param c bitboard userdata.
+-- @param out bitboard userdata to store the result, optional.
+-- @return out or a new bitboard userdata if out is omitted.
+function and_and(a, b, c, out) end
+
 --- Bitboard userdata method to set bits.
 -- @param ... indexes of bits to set.
 -- These arguments have to be numbers between 0 and 63.
@@ -66,6 +106,54 @@ function bb:clrbit63(...) end
 -- @see bb:setbit
 function bb:setbit63(...) end
 
+--- Bitboard userdata method to assign a value in place.
+-- @param x bitboard userdata or number.
+-- @return the bitboard itself.
+function bb:set(x) end
+
+--- Bitboard userdata method to or another bitboard in place.<br />
+-- The in place methods ior, iand, ixor, iandnot, ishl, ishr and inot modify
+-- the bitboard and return it, they don't create new userdata like the
+-- operators do.
+-- @param other bitboard userdata.
+-- @return the bitboard itself.
+function bb:ior(other) end
+
+--- Bitboard userdata method to and another bitboard in place.
+-- @param other bitboard userdata.
+-- @return the bitboard itself.
+-- @see bb:ior
+function bb:iand(other) end
+
+--- Bitboard userdata method to xor another bitboard in place.
+-- @param other bitboard userdata.
+-- @return the bitboard itself.
+-- @see bb:ior
+function bb:ixor(other) end
+
+--- Bitboard userdata method to clear the bits of another bitboard in place.
+-- @param other bitboard userdata.
+-- @return the bitboard itself.
+-- @see bb:ior
+function bb:iandnot(other) end
+
+--- Bitboard userdata method to shift left in place.
+-- @param n shift count, the result is 0 unless it's between 0 and 63.
+-- @return the bitboard itself.
+-- @see bb:ior
+function bb:ishl(n) end
+
+--- Bitboard userdata method to shift right in place.
+-- @param n shift count, the result is 0 unless it's between 0 and 63.
+-- @return the bitboard itself.
+-- @see bb:ior
+function bb:ishr(n) end
+
+--- Bitboard userdata method to invert the bits in place.
+-- @return the bitboard itself.
+-- @see bb:ior
+function bb:inot() end
+
 --- Bitboard userdata method to copy a bitboard.
 -- @return This function returns a bitboard userdata equal to the bitboard
 -- userdata this function is called from.
@@ -86,6 +174,37 @@ function bb:leadz() end
 -- @see bb:leadz
 function bb:trailz() end
 
+--- Bitboard userdata method to count the set bits.
+-- @return the number of bits set.
+function bb:popcount() end
+
+--- Bitboard userdata method to return the least significant set bit.
+-- Unlike bb:trailz this uses the square numbering, rightmost bit is 0.
+-- @return the index of the bit or nil if the bitboard is empty.
+function bb:lsb() end
+
+--- Bitboard userdata method to return the most significant set bit.
+-- Unlike bb:leadz this uses the square numbering, rightmost bit is 0.
+-- @return the index of the bit or nil if the bitboard is empty.
+function bb:msb() end
+
+--- Bitboard userdata method to clear the least significant set bit.
+-- @return the index of the cleared bit or nil if the bitboard is empty.
+-- @see bb:lsb
+function bb:poplsb() end
+
+--- Bitboard userdata method to iterate over the set bits.<br />
+-- <tt>for sq in b:squares() do ... end</tt> visits only the set bits in
+-- ascending order, rightmost bit is 0. The bitboard shouldn't be changed
+-- while it's being iterated.
+-- @return iterator function, the bitboard and the initial square -1.
+function bb:squares() end
+
+--- Bitboard userdata method to get a string holding the value of the bitboard.
+-- Equal bitboards give equal strings so the result can be used as a table key.
+-- @return 8 byte string
+function bb:tokey() end
+
 --- Bitboard metamethod to test equality.
 function bb:__eq(self, other) end
 
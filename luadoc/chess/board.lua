@@ -0,0 +1,260 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+--- board module for luachess.<br />
+-- This is the native position behind <tt>chess.Board</tt>. The fields
+-- <tt>side</tt>, <tt>ep</tt>, <tt>flag</tt>, <tt>li_king</tt>,
+-- <tt>li_rook</tt>, <tt>rhmc</tt> and <tt>fmc</tt> can be read and
+-- assigned like table fields, <tt>flag</tt> only takes castling flags and
+-- <tt>rhmc</tt> at most 16777215 like the FEN parser. The read-only field
+-- <tt>key</tt> is the Zobrist key of the position as a bitboard userdata, it
+-- is updated incrementally when pieces are set or moves are made and unmade.
+module "chess.board"
+
+--- Maximum perft depth.<br />
+-- The number of moves that can be unmade is only limited by memory, the
+-- history grows as needed.
+MAX_DEPTH = 64
+
+--- Maximum number of moves in a position.<br />
+-- Positions aren't checked, so this is room for 64 pieces reaching 27 squares
+-- each.
+MAX_MOVES = 1728
+
+--- Layout of the slider lookup tables, chosen with the MAGIC_LAYOUT cmake
+-- option: <tt>minimized</tt>, <tt>plain</tt>, <tt>perfect</tt> or
+-- <tt>pext</tt>.
+_MAGIC = "minimized"
+
+--- Size of the slider lookup tables in bytes.
+_MAGIC_SIZE = 861184
+
+--- Number of times the lookup tables were built, see chess.attack._INITS.
+_INITS = 1
+
+--- Light userdata pointing to the lookup tables, the same in chess.attack.
+_TABLES = nil
+
+--- Create a new empty board.
+-- @return board userdata, white to move.
+function new() end
+
+--- Board userdata method to put a piece on a square.
+-- @param square Square between 0 and 63.
+-- @param piece Piece, one of chess.attack.PAWN ... chess.attack.KING
+-- @param side chess.attack.WHITE or chess.attack.BLACK
+function board:set_piece(square, piece, side) end
+
+--- Board userdata method to remove a piece from a square.
+-- @param square Square between 0 and 63.
+-- @param piece Piece on the square.
+-- @param side Side of the piece.
+function board:clear_piece(square, piece, side) end
+
+--- Board userdata method to get the piece on a square.
+-- @param square Square between 0 and 63.
+-- @return piece and side or nil if the square is empty.
+function board:get_piece(square) end
+
+--- Board userdata method to test whether a square is occupied.
+-- @param square Square between 0 and 63.
+-- @param side If given, only pieces of this side are considered.
+-- @return boolean
+function board:has_piece(square, side) end
+
+--- Board userdata method to clear the board, counters and move history.
+function board:clear_all() end
+
+--- Board userdata method to get an occupancy bitboard.
+-- @param index 1 is white, 2 is black, 3 is all, 4 is empty.
+-- @return bitboard userdata
+function board:occupied(index) end
+
+--- Board userdata method to get a piece bitboard.
+-- @param side Side of the pieces.
+-- @param piece Type of the pieces.
+-- @return bitboard userdata
+function board:pieces(side, piece) end
+
+--- Board userdata method to get the piece on a square.
+-- @param square Square between 0 and 63.
+-- @return piece or 0 if the square is empty.
+function board:piece_at(square) end
+
+--- Board userdata method to load a position in Forsyth-Edwards Notation.<br />
+-- The board is left untouched if the FEN is invalid.
+-- @param fen FEN string, anything after the move counters is ignored.
+-- @return true or nil, an error message and the 1-based byte offset of the
+-- error.
+function board:loadfen(fen) end
+
+--- Board userdata method to get the position in Forsyth-Edwards Notation.
+-- @return FEN string
+function board:fen() end
+
+--- Board userdata method to find the legal move described in Standard
+-- Algebraic Notation.<br />
+-- Check and annotation suffixes are ignored, castling may be written with
+-- letter O or digit zero and long algebraic forms like Ng1-f3 are accepted.
+-- @param san Move in SAN.
+-- @return move in the format of chess.MOVE() or nil and an error message if
+-- the move is invalid, illegal or ambiguous.
+function board:parse_san(san) end
+
+--- Board userdata method to make a move.
+-- @param move Move in the format of chess.MOVE()
+-- @return move
+function board:make_move(move) end
+
+--- Board userdata method to unmake the last move.
+-- @return The move that was unmade.
+function board:unmake_move() end
+
+--- Board userdata method to get the move history.
+-- @return Table of {move, flag, ep, rhmc} entries, the first entry is a
+-- NULLMOVE holding the values of the initial position.
+function board:history() end
+
+--- Board userdata method to generate the legal moves of the side to move.
+-- Castling moves are encoded as the king moving to the g or c file so that
+-- fischerandom castling works, en passant captures have ENPASSANT set.
+-- @return Table of moves in the format of chess.MOVE()
+function board:legal_moves() end
+
+--- Board userdata method to generate the pseudo legal moves of the side to
+-- move, that is moves which may leave the king in check.
+-- @return Table of moves in the format of chess.MOVE()
+function board:pseudo_moves() end
+
+--- Board userdata method to check whether the side to move is in check.
+-- @return boolean
+function board:in_check() end
+
+--- Board userdata method to count the leaf nodes of the legal move tree.
+-- @param depth Depth of the tree, 0 counts the position itself.
+-- @return number of nodes
+function board:perft(depth) end
+
+--- Board userdata method to count the leaf nodes below each legal move.
+-- @param depth Depth of the tree, must be at least 1.
+-- @return Table mapping moves to their node counts and the total number of
+-- nodes.
+function board:divide(depth) end
+
+--- Open a binary game database.<br />
+-- The file is mapped into memory so games are read without copying and the
+-- page cache is shared between processes. Every game is found through an
+-- offset index. A move takes two bytes: the origin, destination and promotion
+-- bits of chess.MOVE() and a bit marking castling and en passant, captures
+-- are restored from the board. The database userdata has the methods
+-- <tt>count()</tt> (also the length operator), <tt>tags(i)</tt>,
+-- <tt>nmoves(i)</tt>, <tt>replay(i, board, n)</tt>, <tt>moves(i, board)</tt>
+-- and <tt>close()</tt>, documented below.
+-- @param filename Name of the database file.
+-- @return database userdata or nil and an error message.
+function opendb(filename) end
+
+--- Create a binary game database.<br />
+-- The writer userdata has the methods <tt>add(tags, moves)</tt> which
+-- appends a game given a table of its tags and an array of its moves in the
+-- format of chess.MOVE() and returns the number of games written so far, and
+-- <tt>close()</tt> which writes the index and returns true or nil and an error
+-- message. The moves must be legal from the position of the FEN tag or the
+-- initial position, a game that raises an error isn't written at all. The
+-- database is only valid after the writer is closed.
+-- @param filename Name of the database file, it's truncated.
+-- @return writer userdata or nil and an error message.
+function newdb(filename) end
+
+--- Database userdata method to get the tags of a game.
+-- @param i Game number, starting from 1.
+-- @return Table mapping tag names to values.
+function db:tags(i) end
+
+--- Database userdata method to get the number of moves of a game.
+-- @param i Game number, starting from 1.
+-- @return number
+function db:nmoves(i) end
+
+--- Database userdata method to replay a game on a board.<br />
+-- The board is set up from the FEN tag or the initial position. Raises an
+-- error if a stored move is illegal.
+-- @param i Game number, starting from 1.
+-- @param board Board userdata or chess.Board
+-- @param n Number of moves to play, defaults to all of them.
+-- @return number of moves played
+function db:replay(i, board, n) end
+
+--- Database userdata method to get the moves of a game.<br />
+-- The game is replayed on the board which is left at its end.
+-- @param i Game number, starting from 1.
+-- @param board Board userdata or chess.Board
+-- @return Table of moves in the format of chess.MOVE()
+function db:moves(i, board) end
+
+--- Index the positions of a binary game database.<br />
+-- Every game is replayed and the Zobrist key and the material of each of its
+-- positions are written to two sorted tables so that openindex() finds the
+-- games reaching a position with a binary search. Positions take sixteen bytes
+-- each, when the memory given fills up they're sorted and spilled to a
+-- temporary file and the sorted runs are merged into the index at the end.
+-- @param db Database userdata returned by opendb()
+-- @param filename Name of the index file, it's truncated.
+-- @param memory Bytes of memory to use for the positions, defaults to 64 MB.
+-- @return the number of positions or nil and an error message.
+function buildindex(db, filename, memory) end
+
+--- Open a position index created by buildindex().<br />
+-- The file is mapped into memory. The index userdata has the methods
+-- <tt>find(position, limit)</tt>, <tt>material(position, limit)</tt>,
+-- <tt>count()</tt> (also the length operator) which returns the number of
+-- positions and <tt>close()</tt>.
+-- @param filename Name of the index file.
+-- @return index userdata or nil and an error message.
+function openindex(filename) end
+
+--- Index userdata method to find the games reaching a position.<br />
+-- Games are numbered from 1 and plies from 0, db:replay(game, board, ply)
+-- sets the position up. Games reaching the position more than once are
+-- returned once for every ply.
+-- @param position Board userdata, chess.Board or FEN.
+-- @param limit Largest number of matches returned, defaults to all of them.
+-- @return Two arrays, games and plies.
+function ix:find(position, limit) end
+
+--- Index userdata method to find the games reaching the material of a
+-- position.<br />
+-- The ply is the first one the game reaches the material at.
+-- @param position Board userdata, chess.Board, FEN or piece letters like
+-- "KRPkr", kings may be left out.
+-- @param limit Largest number of matches returned, defaults to all of them.
+-- @return Two arrays, games and plies.
+function ix:material(position, limit) end
+
+--- Open a Polyglot opening book.<br />
+-- Use chess.book.open() which documents the methods of the book.
+-- @param filename Name of the book file.
+-- @return book userdata or nil and an error message.
+-- @see chess.book.open
+function openbook(filename) end
+
+--- Compute the Polyglot key of a position.
+-- @param board Board userdata or chess.Board
+-- @return bitboard userdata
+-- @see chess.book.key
+function book_key(board) end
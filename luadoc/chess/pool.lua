@@ -0,0 +1,44 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+--- pool module for luachess<br />
+-- Runs Lua code in a pool of worker threads. Every worker has its own Lua
+-- state with the standard libraries and the package paths of the caller, the
+-- lookup tables of the chess modules are shared read-only. Values passed
+-- between the states are copied, only nil, booleans, numbers, strings and
+-- tables of these can be passed. A worker copies only the tasks it takes.
+module "chess.pool"
+
+--- Whether the workers run in threads.<br />
+-- Without thread support the tasks run one after the other in a single
+-- worker.
+_THREADS = true
+
+--- Run tasks in a pool of workers.
+-- @param code Lua code returning the function every task is passed to. It's
+-- run once per worker.
+-- @param tasks Array of tasks, each task is an array of arguments.
+-- @param workers Number of workers, defaults to the number of processors.
+-- @param prelude Lua code run before code when a worker starts.
+-- @return array with the first result of every task. If a task raises an
+-- error the remaining tasks are abandoned and the error is raised.
+function run(code, tasks, workers, prelude) end
+
+--- Get the number of online processors.
+-- @return number
+function cpus() end
@@ -20,3 +20,20 @@ function timeseal_init_string() end
 -- @param titles Integer given as parameter ti= in seekinfo message.
 function titles_totable(titles) end
 
+--- Split data received from the server into lines.
+-- Carriage returns are dropped and prompts are lines of their own.
+-- @param data Data received from the server, prepended by the rest of the
+-- previous call.
+-- @param timeseal If set to true timeseal pings are returned as false.
+-- @return Array of complete lines and the rest of the data.
+function split_lines(data, timeseal) end
+
+--- Wait until data can be read from file descriptors.
+-- Used by chess.fics.reactor.
+-- @param fds Array of file descriptors.
+-- @param timeout Seconds to wait at most, waits until data is ready if nil or
+-- negative.
+-- @return Array of the indexes of the ready descriptors in fds, nil and error
+-- message on failure.
+function poll(fds, timeout) end
+
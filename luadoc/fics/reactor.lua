@@ -0,0 +1 @@
+../../src/fics/reactor.lua
\ No newline at end of file
@@ -0,0 +1,16 @@
+#!/usr/bin/env luadoc
+-- vim: set ft=lua et sts=4 sw=4 ts=4 fdm=marker:
+
+--- <a href="http://www.chessclub.com">ICC</a> utilities for LuaChess.
+
+module "chess.icc.utils"
+
+--- Split data received from the server into lines and level 2 datagrams.
+-- Carriage returns end lines outside datagrams and linefeeds are dropped.
+-- Datagrams end with the delimiter matching the one they start with, so nested
+-- datagrams are part of the datagram around them.
+-- @param data Data received from the server, prepended by the rest of the
+-- previous call.
+-- @return Array of complete lines and datagrams and the rest of the data.
+function datagrams(data) end
+
@@ -22,89 +22,14 @@
 #include "lauxlib.h"
 
 #include "bitboard.h"
+#include "board.h"
+#include "attack.h"
 #include "magicmoves.h"
-
-#define WHITE 1
-#define BLACK 2
-#define NOCOLOUR 3
-
-#define PAWN 1
-#define KNIGHT 2
-#define BISHOP 3
-#define ROOK 4
-#define QUEEN 5
-#define KING 6
+#include "tables.h"
 
 /* Prototypes */
 LUALIB_API int luaopen_chess_attack(lua_State *L);
 
-static const U64 PAWN_ATTACKS[2][64] = {
-    {0, 0, 0, 0, 0, 0, 0, 0,
-    0x0000000000020000, 0x0000000000050000, 0x00000000000a0000, 0x0000000000140000,
-    0x0000000000280000, 0x0000000000500000, 0x0000000000a00000, 0x0000000000400000,
-    0x0000000002000000, 0x0000000005000000, 0x000000000a000000, 0x0000000014000000,
-    0x0000000028000000, 0x0000000050000000, 0x00000000a0000000, 0x0000000040000000,
-    0x0000000200000000, 0x0000000500000000, 0x0000000a00000000, 0x0000001400000000,
-    0x0000002800000000, 0x0000005000000000, 0x000000a000000000, 0x0000004000000000,
-    0x0000020000000000, 0x0000050000000000, 0x00000a0000000000, 0x0000140000000000,
-    0x0000280000000000, 0x0000500000000000, 0x0000a00000000000, 0x0000400000000000,
-    0x0002000000000000, 0x0005000000000000, 0x000a000000000000, 0x0014000000000000,
-    0x0028000000000000, 0x0050000000000000, 0x00a0000000000000, 0x0040000000000000,
-    0x0200000000000000, 0x0500000000000000, 0x0a00000000000000, 0x1400000000000000,
-    0x2800000000000000, 0x5000000000000000, 0xa000000000000000, 0x4000000000000000,
-    0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0,
-    0x0000000000000002, 0x0000000000000005, 0x000000000000000a, 0x0000000000000014,
-    0x0000000000000028, 0x0000000000000050, 0x00000000000000a0, 0x0000000000000040,
-    0x0000000000000200, 0x0000000000000500, 0x0000000000000a00, 0x0000000000001400,
-    0x0000000000002800, 0x0000000000005000, 0x000000000000a000, 0x0000000000004000,
-    0x0000000000020000, 0x0000000000050000, 0x00000000000a0000, 0x0000000000140000,
-    0x0000000000280000, 0x0000000000500000, 0x0000000000a00000, 0x0000000000400000,
-    0x0000000002000000, 0x0000000005000000, 0x000000000a000000, 0x0000000014000000,
-    0x0000000028000000, 0x0000000050000000, 0x00000000a0000000, 0x0000000040000000,
-    0x0000000200000000, 0x0000000500000000, 0x0000000a00000000, 0x0000001400000000,
-    0x0000002800000000, 0x0000005000000000, 0x000000a000000000, 0x0000004000000000,
-    0x0000020000000000, 0x0000050000000000, 0x00000a0000000000, 0x0000140000000000,
-    0x0000280000000000, 0x0000500000000000, 0x0000a00000000000, 0x0000400000000000,
-    0, 0, 0, 0, 0, 0, 0, 0}
-};
-static const U64 KNIGHT_ATTACKS[64] = {
-    0x0000000000020400, 0x0000000000050800, 0x00000000000a1100, 0x0000000000142200,
-    0x0000000000284400, 0x0000000000508800, 0x0000000000a01000, 0x0000000000402000,
-    0x0000000002040004, 0x8000000005080008, 0x000000000a110011, 0x0000000014220022,
-    0x0000000028440044, 0x0000000050880088, 0x00000000a0100010, 0x0000000040200020,
-    0x0000000204000402, 0x0000000508000885, 0x0000000a1100110a, 0x0000001422002214,
-    0x0000002844004428, 0x0000005088008850, 0x000000a0100010a0, 0x0000004020002040,
-    0x0000020400040200, 0x0000050800088500, 0x00000a1100110a00, 0x0000142200221400,
-    0x0000284400442800, 0x0000508800885000, 0x0000a0100010a000, 0x0000402000204000,
-    0x0002040004020000, 0x0005080008850000, 0x000a1100110a0000, 0x0014220022140000,
-    0x0028440044280000, 0x0050880088500000, 0x00a0100010a00000, 0x0040200020400000,
-    0x0204000402000000, 0x0508000885000000, 0x0a1100110a000000, 0x1422002214000000,
-    0x2844004428000000, 0x5088008850000000, 0xa0100010a0000000, 0x4020002040000000,
-    0x0400040200000000, 0x0800088500000000, 0x1100110a00000000, 0x2200221400000000,
-    0x4400442800000000, 0x8800885000000000, 0x100010a000000000, 0x2000204000000000,
-    0x0004020000000000, 0x0008850000000000, 0x00110a0000000000, 0x0022140000000000,
-    0x0044280000000000, 0x0088500000000000, 0x0010a00000000000, 0x0020400000000000
-};
-static const U64 KING_ATTACKS[64] = {
-    0x0000000000000302, 0x0000000000000705, 0x0000000000000e0a, 0x0000000000001c14,
-    0x0000000000003828, 0x0000000000007050, 0x000000000000e0a0, 0x000000000000c040,
-    0x0000000000030203, 0x0000000000070507, 0x00000000000e0a0e, 0x00000000001c141c,
-    0x0000000000382838, 0x0000000000705070, 0x0000000000e0a0e0, 0x0000000000c040c0,
-    0x0000000003020300, 0x0000000007050700, 0x000000000e0a0e00, 0x000000001c141c00,
-    0x0000000038283800, 0x0000000070507000, 0x00000000e0a0e000, 0x00000000c040c000,
-    0x0000000302030000, 0x0000000705070000, 0x0000000e0a0e0000, 0x0000001c141c0000,
-    0x0000003828380000, 0x0000007050700000, 0x000000e0a0e00000, 0x000000c040c00000,
-    0x0000030203000000, 0x0000070507000000, 0x00000e0a0e000000, 0x00001c141c000000,
-    0x0000382838000000, 0x0000705070000000, 0x0000e0a0e0000000, 0x0000c040c0000000,
-    0x0003020300000000, 0x0007050700000000, 0x000e0a0e00000000, 0x001c141c00000000,
-    0x0038283800000000, 0x0070507000000000, 0x00e0a0e000000000, 0x00c040c000000000,
-    0x0302030000000000, 0x0705070000000000, 0x0e0a0e0000000000, 0x1c141c0000000000,
-    0x3828380000000000, 0x7050700000000000, 0xe0a0e00000000000, 0xc040c00000000000,
-    0x0203000000000000, 0x0507000000000000, 0x0a0e000000000000, 0x141c000000000000,
-    0x2838000000000000, 0x5070000000000000, 0xa0e0000000000000, 0x40c0000000000000
-};
-
 static int atak(lua_State *L) {
     int piece, square, colour;
     U64 *ret = NULL;
@@ -161,15 +86,285 @@ static int atak(lua_State *L) {
     return 1;
 }
 
+/* Accepts a chess.board userdata or a chess.Board which keeps one in core. */
+static struct board *check_board(lua_State *L, int narg) {
+    struct board *b;
+
+    if (LUA_TTABLE == lua_type(L, narg)) {
+        lua_getfield(L, narg, "core");
+        b = luaL_checkudata(L, -1, BOARD_T);
+        lua_pop(L, 1);
+        return b;
+    }
+    return luaL_checkudata(L, narg, BOARD_T);
+}
+
+static inline void push_bitboard(lua_State *L, U64 value) {
+    U64 *bb;
+
+    bb = (U64 *)lua_newuserdata(L, sizeof(U64));
+    luaL_getmetatable(L, BITBOARD_T);
+    lua_setmetatable(L, -2);
+    *bb = value;
+}
+
+/* attackers_to(board, square, side) returns the pieces of side attacking the
+ * square, pieces of both sides if side is nil.
+ */
+static int attackers_to(lua_State *L) {
+    int square, colour;
+    U64 occ;
+    struct board *b;
+
+    b = check_board(L, 1);
+    square = luaL_checkinteger(L, 2);
+    if (square < 0 || square > 63)
+        return luaL_argerror(L, 2, "invalid square");
+    if (!lua_isnoneornil(L, 3)) {
+        colour = luaL_checkinteger(L, 3);
+        if (colour < WHITE || colour > BLACK)
+            return luaL_argerror(L, 3, "invalid colour");
+    }
+    else colour = NOCOLOUR;
+
+    occ = b->occupied[OCC_ALL];
+    if (NOCOLOUR == colour)
+        push_bitboard(L, board_attackers(b, square, WHITE, occ)
+                | board_attackers(b, square, BLACK, occ));
+    else
+        push_bitboard(L, board_attackers(b, square, colour, occ));
+    return 1;
+}
+
+/* attacked_by(board, side) returns the squares attacked by side. */
+static int attacked_by(lua_State *L) {
+    int colour;
+    struct board *b;
+
+    b = check_board(L, 1);
+    colour = luaL_checkinteger(L, 2);
+    if (colour < WHITE || colour > BLACK)
+        return luaL_argerror(L, 2, "invalid colour");
+
+    push_bitboard(L, board_attacked_by(b, colour));
+    return 1;
+}
+
+static inline int check_square(lua_State *L, int narg) {
+    int square;
+
+    square = luaL_checkinteger(L, narg);
+    if (square < 0 || square > 63)
+        luaL_argerror(L, narg, "invalid square");
+    return square;
+}
+
+/* between(a, b) returns the squares strictly between a and b, empty if they
+ * aren't on the same rank, file or diagonal.
+ */
+static int between(lua_State *L) {
+    int a, b;
+
+    a = check_square(L, 1);
+    b = check_square(L, 2);
+    push_bitboard(L, BETWEEN[a][b]);
+    return 1;
+}
+
+/* line(a, b) returns the whole line through a and b, empty if they aren't on
+ * the same rank, file or diagonal.
+ */
+static int line(lua_State *L) {
+    int a, b;
+
+    a = check_square(L, 1);
+    b = check_square(L, 2);
+    push_bitboard(L, LINE[a][b]);
+    return 1;
+}
+
+/* ray(square, direction) returns the squares from square to the edge of the
+ * board in the given direction, square excluded.
+ */
+static int ray(lua_State *L) {
+    int square, dir;
+
+    square = check_square(L, 1);
+    dir = luaL_checkinteger(L, 2);
+    if (dir < NORTH || dir > NORTHWEST)
+        return luaL_argerror(L, 2, "invalid direction");
+    push_bitboard(L, RAYS[dir][square]);
+    return 1;
+}
+
+static int distance(lua_State *L) {
+    int a, b;
+
+    a = check_square(L, 1);
+    b = check_square(L, 2);
+    lua_pushinteger(L, DISTANCE[a][b]);
+    return 1;
+}
+
+static int manhattan(lua_State *L) {
+    int a, b;
+
+    a = check_square(L, 1);
+    b = check_square(L, 2);
+    lua_pushinteger(L, MANHATTAN(a, b));
+    return 1;
+}
+
+static int rank_mask(lua_State *L) {
+    push_bitboard(L, RANK_MASK[check_square(L, 1)]);
+    return 1;
+}
+
+static int file_mask(lua_State *L) {
+    push_bitboard(L, FILE_MASK[check_square(L, 1)]);
+    return 1;
+}
+
+static int diagonal_mask(lua_State *L) {
+    push_bitboard(L, DIAGONAL_MASK[check_square(L, 1)]);
+    return 1;
+}
+
+static int antidiagonal_mask(lua_State *L) {
+    push_bitboard(L, ANTIDIAGONAL_MASK[check_square(L, 1)]);
+    return 1;
+}
+
+/* Piece values used by the static exchange evaluation, indexed by piece. */
+static const int see_value[7] = {0, 100, 325, 325, 500, 975, 10000};
+
+/* Static exchange evaluation of the move, the material balance for the moving
+ * side after every profitable recapture on the target square is played out,
+ * least valuable attacker first. Attackers revealed behind the pieces taking
+ * part are picked up by recomputing the sliders with the shrinking occupancy.
+ */
+static int board_see(const struct board *b, int move) {
+    int d, side, from, to, piece, p;
+    int gain[64]; /* every capture removes a piece from the board */
+    U64 occ, attackers, mine, bb;
+
+    from = FROMSQ(move);
+    to = TOSQ(move);
+    side = board_side_at(b, from);
+    piece = b->cboard[from];
+    occ = b->occupied[OCC_ALL];
+
+    if (move & ENPASSANT) {
+        gain[0] = see_value[PAWN];
+        occ &= ~(1ULL << ((WHITE == side) ? to - 8 : to + 8));
+    }
+    else if (move & CAPTURE)
+        gain[0] = see_value[CAPTURE_PIECE(move)];
+    else
+        gain[0] = see_value[b->cboard[to]];
+    if (move & PROMOTION) {
+        piece = PROMOTE_PIECE(move);
+        gain[0] += see_value[piece] - see_value[PAWN];
+    }
+    occ &= ~(1ULL << from);
+    attackers = (board_attackers(b, to, WHITE, occ) | board_attackers(b, to, BLACK, occ)) & occ;
+    side = XSIDE(side);
+
+    d = 0;
+    for (;;) {
+        mine = attackers & b->occupied[side - 1];
+        if (!mine || 63 == d)
+            break;
+        /* The king may not capture a defended piece. */
+        if (KING == piece && d > 0) {
+            d--;
+            break;
+        }
+
+        for (p = PAWN; p < KING; p++) {
+            if ((bb = mine & b->pieces[side - 1][p - 1]))
+                break;
+        }
+        if (KING == p)
+            bb = mine & b->pieces[side - 1][KING - 1];
+
+        d++;
+        gain[d] = see_value[piece] - gain[d - 1];
+        piece = p;
+        if (PAWN == p && ((1ULL << to) & (RANK_1 | RANK_8))) {
+            gain[d] += see_value[QUEEN] - see_value[PAWN];
+            piece = QUEEN;
+        }
+
+        occ &= ~(bb & -bb);
+        attackers = (board_attackers(b, to, WHITE, occ) | board_attackers(b, to, BLACK, occ)) & occ;
+        side = XSIDE(side);
+    }
+
+    for (; d > 0; d--)
+        gain[d - 1] = -(-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]);
+    return gain[0];
+}
+
+/* see(board, move) returns the static exchange evaluation of the move. */
+static int see(lua_State *L) {
+    int move;
+    struct board *b;
+
+    b = check_board(L, 1);
+    move = luaL_checkinteger(L, 2);
+    if (!(b->occupied[OCC_ALL] & (1ULL << FROMSQ(move))))
+        return luaL_argerror(L, 2, "no piece on the from square");
+
+    lua_pushinteger(L, board_see(b, move));
+    return 1;
+}
+
 static const struct luaL_reg attack_global[] = {
     {"atak", atak},
+    {"attackers_to", attackers_to},
+    {"attacked_by", attacked_by},
+    {"see", see},
+    {"between", between},
+    {"line", line},
+    {"ray", ray},
+    {"distance", distance},
+    {"manhattan", manhattan},
+    {"rank_mask", rank_mask},
+    {"file_mask", file_mask},
+    {"diagonal_mask", diagonal_mask},
+    {"antidiagonal_mask", antidiagonal_mask},
     {NULL, NULL}
 };
 
 LUALIB_API int luaopen_chess_attack(lua_State *L) {
-    initmagicmoves();
+    int inits;
+
+    if (!MAGICMOVES_SUPPORTED())
+        return luaL_error(L, "the " MAGICMOVES_LAYOUT " slider tables aren't supported by this CPU");
+    inits = tables_setup();
     luaL_register(L, "chess.attack", attack_global);
 
+    /* Push the layout and size of the slider lookup tables */
+    lua_pushliteral(L, "_MAGIC");
+    lua_pushliteral(L, MAGICMOVES_LAYOUT);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "_MAGIC_SIZE");
+    lua_pushinteger(L, MAGICMOVES_SIZE);
+    lua_settable(L, -3);
+
+    /* Push how many times the tables were built, once per process, and where
+     * they are
+     */
+    lua_pushliteral(L, "_INITS");
+    lua_pushinteger(L, inits);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "_TABLES");
+    lua_pushlightuserdata(L, RAYS);
+    lua_settable(L, -3);
+
     /* Push colours */
     lua_pushliteral(L, "WHITE");
     lua_pushinteger(L, WHITE);
@@ -208,6 +403,39 @@ LUALIB_API int luaopen_chess_attack(lua_State *L) {
     lua_pushinteger(L, KING);
     lua_settable(L, -3);
 
+    /* Push directions */
+    lua_pushliteral(L, "NORTH");
+    lua_pushinteger(L, NORTH);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "NORTHEAST");
+    lua_pushinteger(L, NORTHEAST);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "EAST");
+    lua_pushinteger(L, EAST);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "SOUTHEAST");
+    lua_pushinteger(L, SOUTHEAST);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "SOUTH");
+    lua_pushinteger(L, SOUTH);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "SOUTHWEST");
+    lua_pushinteger(L, SOUTHWEST);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "WEST");
+    lua_pushinteger(L, WEST);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "NORTHWEST");
+    lua_pushinteger(L, NORTHWEST);
+    lua_settable(L, -3);
+
     return 1;
 }
 
@@ -0,0 +1,70 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LUACHESS_GUARD_ATTACK_H
+#define LUACHESS_GUARD_ATTACK_H 1
+
+#include "bitboard.h"
+#include "board.h"
+#include "magicmoves.h"
+#include "tables.h"
+
+/* Squares attacked by the pawns in bb of the given side. */
+static inline U64 pawn_attacks(U64 bb, int side) {
+    if (WHITE == side)
+        return ((bb << 7) & ~FILE_H) | ((bb << 9) & ~FILE_A);
+    else
+        return ((bb >> 9) & ~FILE_H) | ((bb >> 7) & ~FILE_A);
+}
+
+/* Pieces of the given side attacking sq when the occupied squares are occ. */
+static inline U64 board_attackers(const struct board *b, int sq, int side, U64 occ) {
+    const U64 *p = b->pieces[side - 1];
+
+    return (pawn_attacks(1ULL << sq, XSIDE(side)) & p[PAWN - 1])
+        | (KNIGHT_ATTACKS[sq] & p[KNIGHT - 1])
+        | (KING_ATTACKS[sq] & p[KING - 1])
+        | (Bmagic(sq, occ) & (p[BISHOP - 1] | p[QUEEN - 1]))
+        | (Rmagic(sq, occ) & (p[ROOK - 1] | p[QUEEN - 1]));
+}
+
+/* Squares attacked by the pieces of the given side. */
+static inline U64 board_attacked_by(const struct board *b, int side) {
+    int sq;
+    const U64 *p = b->pieces[side - 1];
+    U64 occ = b->occupied[OCC_ALL];
+    U64 bb, ret;
+
+    ret = pawn_attacks(p[PAWN - 1], side);
+    for (bb = p[KNIGHT - 1]; bb; bb &= bb - 1)
+        ret |= KNIGHT_ATTACKS[bitscan(bb)];
+    for (bb = p[KING - 1]; bb; bb &= bb - 1)
+        ret |= KING_ATTACKS[bitscan(bb)];
+    for (bb = p[BISHOP - 1] | p[QUEEN - 1]; bb; bb &= bb - 1) {
+        sq = bitscan(bb);
+        ret |= Bmagic(sq, occ);
+    }
+    for (bb = p[ROOK - 1] | p[QUEEN - 1]; bb; bb &= bb - 1) {
+        sq = bitscan(bb);
+        ret |= Rmagic(sq, occ);
+    }
+    return ret;
+}
+
+#endif /* LUACHESS_GUARD_ATTACK_H */
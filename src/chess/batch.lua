@@ -0,0 +1,196 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Batch module for LuaChess
+-- Splits PGN and EPD files at game boundaries and processes the pieces in a
+-- pool of worker threads, each with its own Lua state. The lookup tables of
+-- the chess modules are built once per process and shared read-only by the
+-- workers.
+
+--{{{Grab environment
+local assert = assert
+local ipairs = ipairs
+local type = type
+
+local io = io
+local math = math
+local string = string
+
+local pool = require "chess.pool"
+--}}}
+--{{{Shortcuts to module functions
+local find, sub = string.find, string.sub
+--}}}
+
+module "chess.batch"
+
+--- Number of bytes read at a time when looking for a boundary or reading a
+-- range.
+CHUNK_SIZE = 65536
+
+--{{{Splitting
+-- Patterns matching the start of a game, the offset of the last character of
+-- the match is the boundary.
+local boundaries = {
+    -- A tag after an empty line
+    pgn = "\n[ \t\r]*\n%[",
+    -- Any line
+    epd = "\n.",
+}
+
+-- Returns the offset of the first boundary at or after offset, size if
+-- there's none.
+local function boundary(file, offset, size, format)
+    local pattern = assert(boundaries[format], "invalid format")
+    local window = ""
+    local base = offset
+    file:seek("set", offset)
+    while true do
+        local chunk = file:read(CHUNK_SIZE)
+        if not chunk then return size end
+        window = window .. chunk
+        local _, e = find(window, pattern)
+        if e then return base + e - 1 end
+        -- Keep a short tail in case the boundary is cut.
+        if #window > 64 then
+            base = base + #window - 64
+            window = sub(window, -64)
+        end
+    end
+end
+
+--- Splits a file into at most n byte ranges which start at game boundaries.<br />
+-- format is "pgn" or "epd". Returns an array of {first, last} pairs, first
+-- is the zero based offset of the first byte and last of the byte after the
+-- range.
+function split(filename, format, n)
+    local file = assert(io.open(filename, "rb"))
+    local size = file:seek("end")
+    local ranges, first = {}, 0
+    for i=1,n - 1 do
+        local target = math.floor(size * i / n)
+        if target > first then
+            local b = boundary(file, target, size, format)
+            if b >= size then break end
+            ranges[#ranges + 1] = {first, b}
+            first = b
+        end
+    end
+    file:close()
+    if size > first then ranges[#ranges + 1] = {first, size} end
+    return ranges
+end
+--}}}
+--{{{Reading ranges
+--- Returns a source for chess.pgn reading the bytes from first up to last of
+-- a file.
+function range(filename, first, last)
+    local file = assert(io.open(filename, "rb"))
+    file:seek("set", first)
+    local left = last - first
+    return function (n)
+        local chunk = file and left > 0 and file:read(n < left and n or left)
+        if not chunk then
+            if file then
+                file:close()
+                file = nil
+            end
+            return nil
+        end
+        left = left - #chunk
+        return chunk
+    end
+end
+
+--- Returns an iterator over the lines of a source, the line terminators are
+-- stripped.
+function lines(source, chunksize)
+    chunksize = chunksize or CHUNK_SIZE
+    local buf, pos = "", 1
+    return function ()
+        while true do
+            local e = find(buf, "\n", pos, true)
+            if e then
+                local line = sub(buf, pos, e - 1)
+                pos = e + 1
+                if sub(line, -1) == "\r" then line = sub(line, 1, -2) end
+                return line
+            end
+            local chunk = source(chunksize)
+            if not chunk then
+                if pos > #buf then return nil end
+                local line = sub(buf, pos)
+                buf, pos = "", 1
+                return line
+            end
+            buf, pos = sub(buf, pos) .. chunk, 1
+        end
+    end
+end
+--}}}
+--{{{Running
+-- Code run by the workers, it loads the mapper once per worker.
+local worker = [[
+local batch = require "chess.batch"
+local mapper
+return function (code, filename, first, last, format)
+    if not mapper then mapper = assert(loadstring(code, "=mapper"))() end
+    return mapper(batch.range(filename, first, last), format)
+end
+]]
+
+--- Processes a PGN or EPD file in a pool of worker threads.<br />
+-- The file is split at game boundaries into pieces, every piece is handed to
+-- the mapper in one of the workers and the results are merged in order with
+-- the reducer. The options are:
+-- <ul>
+-- <li>mapper, Lua code returning a function which is called with a source
+-- for chess.pgn or lines() and the format, it must return a value made of
+-- nil, booleans, numbers, strings and tables. Required.</li>
+-- <li>reducer, function called with the accumulator and the result of a
+-- piece, returns the new accumulator. Required.</li>
+-- <li>init, initial value of the accumulator.</li>
+-- <li>format, "pgn" or "epd", defaults to "pgn".</li>
+-- <li>workers, number of threads, defaults to the number of processors.</li>
+-- <li>pieces, number of pieces, defaults to four per worker.</li>
+-- <li>prelude, Lua code run when a worker starts, e.g. to set up package
+-- loaders.</li>
+-- </ul>
+-- Errors in the workers are raised in the caller.
+-- @return the accumulator
+function run(filename, options)
+    assert(type(options) == "table", "options not a table")
+    assert(type(options.mapper) == "string", "mapper not a string")
+    assert(type(options.reducer) == "function", "reducer not a function")
+    local format = options.format or "pgn"
+    local workers = options.workers or pool.cpus()
+    local ranges = split(filename, format, options.pieces or workers * 4)
+
+    local tasks = {}
+    for i, r in ipairs(ranges) do
+        tasks[i] = {options.mapper, filename, r[1], r[2], format}
+    end
+    local results = pool.run(worker, tasks, workers, options.prelude)
+
+    local acc = options.init
+    for i=1,#tasks do
+        if results[i] ~= nil then acc = options.reducer(acc, results[i]) end
+    end
+    return acc
+end
+--}}}
@@ -0,0 +1,332 @@
+/* Packed bitboard arrays for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h> /* for memset, memcpy */
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "lua.h"
+#include "lauxlib.h"
+
+#include "bitboard.h"
+
+/* Prototypes */
+void bbarray_open(lua_State *L);
+U64 *bitboard_checkmutable(lua_State *L, int narg); /* bitboard.c */
+U64 bitboard_checknumber(lua_State *L, int narg); /* bitboard.c */
+
+/* Largest number of bitboards in an array. */
+#define BBARRAY_MAX (1 << 24)
+
+#if defined(__AVX2__)
+#define BBARRAY_SIMD "avx2"
+#elif defined(__SSE2__)
+#define BBARRAY_SIMD "sse2"
+#else
+#define BBARRAY_SIMD "none"
+#endif
+
+/* N bitboards stored contiguously in one userdata. */
+struct bbarray {
+    int n;
+    U64 v[];
+};
+
+/* Lane-wise kernels, the vector loops use unaligned loads because userdata
+ * is only guaranteed to be aligned for doubles.
+ */
+#if defined(__AVX2__)
+#define BBARRAY_KERNEL(name, op, vop)                                   \
+static void name(U64 *a, const U64 *b, int n) {                         \
+    int i = 0;                                                          \
+    for (; i + 4 <= n; i += 4) {                                        \
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));       \
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));       \
+        _mm256_storeu_si256((__m256i *)(a + i), _mm256_##vop(x, y));    \
+    }                                                                   \
+    for (; i < n; i++)                                                  \
+        a[i] op b[i];                                                   \
+}
+#elif defined(__SSE2__)
+#define BBARRAY_KERNEL(name, op, vop)                                   \
+static void name(U64 *a, const U64 *b, int n) {                         \
+    int i = 0;                                                          \
+    for (; i + 2 <= n; i += 2) {                                        \
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));          \
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));          \
+        _mm_storeu_si128((__m128i *)(a + i), _mm_##vop(x, y));          \
+    }                                                                   \
+    for (; i < n; i++)                                                  \
+        a[i] op b[i];                                                   \
+}
+#else
+#define BBARRAY_KERNEL(name, op, vop)                                   \
+static void name(U64 *a, const U64 *b, int n) {                         \
+    int i;                                                              \
+    for (i = 0; i < n; i++)                                             \
+        a[i] op b[i];                                                   \
+}
+#endif
+
+#if defined(__AVX2__)
+BBARRAY_KERNEL(kernel_or, |=, or_si256)
+BBARRAY_KERNEL(kernel_and, &=, and_si256)
+BBARRAY_KERNEL(kernel_xor, ^=, xor_si256)
+#else
+BBARRAY_KERNEL(kernel_or, |=, or_si128)
+BBARRAY_KERNEL(kernel_and, &=, and_si128)
+BBARRAY_KERNEL(kernel_xor, ^=, xor_si128)
+#endif
+
+/* Sum of the population counts of the lanes. With AVX2 the bytes are counted
+ * with a nibble lookup table and summed with vpsadbw.
+ */
+static U64 kernel_popcount(const U64 *a, int n) {
+    int i = 0;
+    U64 total = 0;
+#if defined(__AVX2__)
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    U64 lanes[4];
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i lo = _mm256_and_si256(v, low);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                _mm256_shuffle_epi8(lookup, hi));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; i++)
+        total += popcount(a[i]);
+    return total;
+}
+
+static inline struct bbarray *check_array(lua_State *L, int narg) {
+    return luaL_checkudata(L, narg, BITBOARD_ARRAY_T);
+}
+
+static inline int check_index(lua_State *L, const struct bbarray *a, int narg) {
+    int i;
+
+    i = luaL_checkinteger(L, narg);
+    if (i < 1 || i > a->n)
+        luaL_argerror(L, narg, "index out of range");
+    return i - 1;
+}
+
+static inline struct bbarray *check_other(lua_State *L, const struct bbarray *a, int narg) {
+    struct bbarray *b;
+
+    b = check_array(L, narg);
+    if (b->n != a->n)
+        luaL_argerror(L, narg, "array sizes differ");
+    return b;
+}
+
+static int bbarray_new(lua_State *L) {
+    int n;
+    struct bbarray *a;
+
+    n = luaL_checkinteger(L, 1);
+    if (n < 1 || n > BBARRAY_MAX)
+        return luaL_argerror(L, 1, "invalid size");
+
+    a = (struct bbarray *)lua_newuserdata(L, sizeof(struct bbarray) + n * sizeof(U64));
+    luaL_getmetatable(L, BITBOARD_ARRAY_T);
+    lua_setmetatable(L, -2);
+
+    a->n = n;
+    memset(a->v, 0, n * sizeof(U64));
+    return 1;
+}
+
+static int bbarray_len(lua_State *L) {
+    lua_pushinteger(L, check_array(L, 1)->n);
+    return 1;
+}
+
+/* a:get(i, out) returns the i'th bitboard, it's written to out if given. */
+static int bbarray_get(lua_State *L) {
+    int i;
+    U64 *out;
+    struct bbarray *a;
+
+    a = check_array(L, 1);
+    i = check_index(L, a, 2);
+    if (!lua_isnoneornil(L, 3)) {
+        out = bitboard_checkmutable(L, 3);
+        lua_settop(L, 3);
+    }
+    else {
+        out = (U64 *)lua_newuserdata(L, sizeof(U64));
+        luaL_getmetatable(L, BITBOARD_T);
+        lua_setmetatable(L, -2);
+    }
+    *out = a->v[i];
+    return 1;
+}
+
+/* a:set(i, x) sets the i'th bitboard to a bitboard or a number. */
+static int bbarray_set(lua_State *L) {
+    int i;
+    struct bbarray *a;
+
+    a = check_array(L, 1);
+    i = check_index(L, a, 2);
+    if (LUA_TNUMBER == lua_type(L, 3))
+        a->v[i] = bitboard_checknumber(L, 3);
+    else
+        a->v[i] = *(U64 *)luaL_checkudata(L, 3, BITBOARD_T);
+    return 0;
+}
+
+/* a:fill(x) sets every bitboard to a bitboard or a number. */
+static int bbarray_fill(lua_State *L) {
+    int i;
+    U64 x;
+    struct bbarray *a;
+
+    a = check_array(L, 1);
+    if (LUA_TNUMBER == lua_type(L, 2))
+        x = bitboard_checknumber(L, 2);
+    else
+        x = *(U64 *)luaL_checkudata(L, 2, BITBOARD_T);
+    for (i = 0; i < a->n; i++)
+        a->v[i] = x;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bbarray_copy(lua_State *L) {
+    struct bbarray *a, *ret;
+
+    a = check_array(L, 1);
+
+    ret = (struct bbarray *)lua_newuserdata(L, sizeof(struct bbarray) + a->n * sizeof(U64));
+    luaL_getmetatable(L, BITBOARD_ARRAY_T);
+    lua_setmetatable(L, -2);
+
+    ret->n = a->n;
+    memcpy(ret->v, a->v, a->n * sizeof(U64));
+    return 1;
+}
+
+/* Bulk operations, these work lane by lane with another array of the same
+ * size, modify the array and return it.
+ */
+static int bbarray_ior(lua_State *L) {
+    struct bbarray *a, *b;
+
+    a = check_array(L, 1);
+    b = check_other(L, a, 2);
+
+    kernel_or(a->v, b->v, a->n);
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bbarray_iand(lua_State *L) {
+    struct bbarray *a, *b;
+
+    a = check_array(L, 1);
+    b = check_other(L, a, 2);
+
+    kernel_and(a->v, b->v, a->n);
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bbarray_ixor(lua_State *L) {
+    struct bbarray *a, *b;
+
+    a = check_array(L, 1);
+    b = check_other(L, a, 2);
+
+    kernel_xor(a->v, b->v, a->n);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/* Returns the total number of set bits in all the bitboards. */
+static int bbarray_popcount(lua_State *L) {
+    struct bbarray *a;
+
+    a = check_array(L, 1);
+    lua_pushnumber(L, (lua_Number)kernel_popcount(a->v, a->n));
+    return 1;
+}
+
+/* Returns the union of all the bitboards. */
+static int bbarray_union(lua_State *L) {
+    int i;
+    U64 *ret;
+    struct bbarray *a;
+
+    a = check_array(L, 1);
+
+    ret = (U64 *)lua_newuserdata(L, sizeof(U64));
+    luaL_getmetatable(L, BITBOARD_T);
+    lua_setmetatable(L, -2);
+
+    *ret = 0;
+    for (i = 0; i < a->n; i++)
+        *ret |= a->v[i];
+    return 1;
+}
+
+static const struct luaL_reg bbarray_methods[] = {
+    {"__len", bbarray_len},
+    {"get", bbarray_get},
+    {"set", bbarray_set},
+    {"fill", bbarray_fill},
+    {"copy", bbarray_copy},
+    {"ior", bbarray_ior},
+    {"iand", bbarray_iand},
+    {"ixor", bbarray_ixor},
+    {"popcount", bbarray_popcount},
+    {"union", bbarray_union},
+    {NULL, NULL}
+};
+
+void bbarray_open(lua_State *L) {
+    /* Register BITBOARD_ARRAY_T metatable */
+    luaL_newmetatable(L, BITBOARD_ARRAY_T);
+    luaL_register(L, NULL, bbarray_methods);
+    lua_pushliteral(L, "__index");
+    lua_pushvalue(L, -2);
+    lua_settable(L, -3);
+    lua_pop(L, 1);
+
+    /* Push array and the SIMD kernels in use to the module table */
+    lua_pushliteral(L, "array");
+    lua_pushcfunction(L, bbarray_new);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "_ARRAY_SIMD");
+    lua_pushliteral(L, BBARRAY_SIMD);
+    lua_settable(L, -3);
+}
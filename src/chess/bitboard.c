@@ -28,12 +28,18 @@
 #include "lauxlib.h"
 
 #include "bitboard.h"
+#include "once.h"
 
+#ifndef HAVE_BUILTIN_CLZLL
 #define NBITS 16
 static unsigned char lz_array[65536];
+#endif /* !HAVE_BUILTIN_CLZLL */
 
 /* Prototypes */
 LUALIB_API int luaopen_chess_bitboard(lua_State *L);
+void bbarray_open(lua_State *L); /* bbarray.c */
+U64 *bitboard_checkmutable(lua_State *L, int narg);
+U64 bitboard_checknumber(lua_State *L, int narg);
 
 #if 0
 static void dumpstack(lua_State *L)
@@ -67,6 +73,17 @@ static void dumpstack(lua_State *L)
 }
 #endif
 
+#ifdef HAVE_BUILTIN_CLZLL
+/* Returns the leading bit in a bitboard, 64 if the bitboard is empty.
+ * Leftmost bit is 0 and rightmost bit is 63.
+ */
+static inline int leadz(U64 b) {
+    return b ? __builtin_clzll(b) : 64;
+}
+
+/* Index of the most significant one bit, b must not be zero. */
+#define bitscan_rev(b) (63 - __builtin_clzll(b))
+#else
 /*  Creates the lz_array. This array is used when the position of the leading
  *  non-zero bit is required.  The convention used is that the leftmost bit is
  *  considered as position 0 and the rightmost bit position 63.
@@ -84,18 +101,22 @@ static void init_lz_array(void) {
    }
 }
 
-/* Returns the leading bit in a bitboard.
+/* Returns the leading bit in a bitboard, 64 if the bitboard is empty.
  * Leftmost bit is 0 and rightmost bit is 63.
  * Thanks to Robert Hyatt for this algorithm.
  */
-static inline unsigned char leadz(U64 b) {
+static inline int leadz(U64 b) {
   if (b >> 48) return lz_array[b >> 48];
   if (b >> 32) return lz_array[b >> 32] + 16;
   if (b >> 16) return lz_array[b >> 16] + 32;
-  return lz_array[b] + 48;
+  if (b) return lz_array[b] + 48;
+  return 64;
 }
 
-#define trailz(b) (leadz ((b) & ((~b) + 1)))
+#define bitscan_rev(b) (63 - leadz(b))
+#endif /* HAVE_BUILTIN_CLZLL */
+
+#define trailz(b) ((b) ? 63 - bitscan(b) : 64)
 
 /* Initialization and display */
 static int bitboard_new(lua_State *L) {
@@ -169,12 +190,79 @@ static int bitboard_copy(lua_State *L) {
     return 1;
 }
 
+/* Checks for a bitboard which may be changed in place. */
+U64 *bitboard_checkmutable(lua_State *L, int narg) {
+    U64 *bb;
+
+    bb = luaL_checkudata(L, narg, BITBOARD_T);
+    if (lua_objlen(L, narg) != sizeof(U64))
+        luaL_argerror(L, narg, "read only bitboard, use copy()");
+    return bb;
+}
+
+/* Converts the number at narg to a bitboard, converting negative numbers or
+ * numbers too large for a bitboard is undefined so they're rejected.
+ */
+U64 bitboard_checknumber(lua_State *L, int narg) {
+    lua_Number n;
+
+    n = luaL_checknumber(L, narg);
+    if (!(n >= 0 && n < 18446744073709551616.0))
+        luaL_argerror(L, narg, "number out of range");
+    return (U64) n;
+}
+
+/* Iterating */
+
+/* Iterator function of bb:squares(), returns the first set bit above the
+ * previous square or nothing when there are no more squares.
+ */
+static int bitboard_squares_next(lua_State *L) {
+    int prev;
+    U64 *bb, rest;
+
+    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    prev = luaL_checkinteger(L, 2);
+    if (prev < -1)
+        return luaL_argerror(L, 2, "invalid square");
+    if (prev >= 63)
+        return 0;
+    rest = *bb & (~0ULL << (prev + 1));
+    if (0 == rest)
+        return 0;
+    lua_pushinteger(L, bitscan(rest));
+    return 1;
+}
+
+/* Returns an iterator over the set bits of the bitboard in ascending order.
+ * The iterator function is kept as an upvalue so that no closure is created
+ * for every loop.
+ */
+static int bitboard_squares(lua_State *L) {
+    luaL_checkudata(L, 1, BITBOARD_T);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, -1);
+    return 3;
+}
+
+/* Returns the value as an 8 byte string which, unlike the userdata itself,
+ * can be used as a table key.
+ */
+static int bitboard_tokey(lua_State *L) {
+    U64 *bb;
+
+    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    lua_pushlstring(L, (const char *)bb, sizeof(U64));
+    return 1;
+}
+
 /* Setting, testing bits  */
 static int bitboard_setbit(lua_State *L) {
     int ind, sq;
     U64 *bb;
 
-    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    bb = bitboard_checkmutable(L, 1);
     for (ind = 2; !lua_isnone(L, ind); ind++) {
         sq = luaL_checkinteger(L, ind);
         if (sq < 0 || sq > 63)
@@ -188,7 +276,7 @@ static int bitboard_clrbit(lua_State *L) {
     int ind, sq;
     U64 *bb;
 
-    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    bb = bitboard_checkmutable(L, 1);
     for (ind = 2; !lua_isnone(L, ind); ind++) {
         sq = luaL_checkinteger(L, ind);
         if (sq < 0 || sq > 63)
@@ -202,7 +290,7 @@ static int bitboard_tglbit(lua_State *L) {
     int ind, sq;
     U64 *bb;
 
-    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    bb = bitboard_checkmutable(L, 1);
     for (ind = 2; !lua_isnone(L, ind); ind++) {
         sq = luaL_checkinteger(L, ind);
         if (sq < 0 || sq > 63)
@@ -236,7 +324,7 @@ static int bitboard_setbit63(lua_State *L) {
     int ind, sq;
     U64 *bb;
 
-    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    bb = bitboard_checkmutable(L, 1);
     for (ind = 2; !lua_isnone(L, ind); ind++) {
         sq = luaL_checkinteger(L, ind);
         if (sq < 0 || sq > 63)
@@ -250,7 +338,7 @@ static int bitboard_clrbit63(lua_State *L) {
     int ind, sq;
     U64 *bb;
 
-    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    bb = bitboard_checkmutable(L, 1);
     for (ind = 2; !lua_isnone(L, ind); ind++) {
         sq = luaL_checkinteger(L, ind);
         if (sq < 0 || sq > 63)
@@ -393,6 +481,156 @@ static int bitboard_not(lua_State *L) {
     return 1;
 }
 
+/* In place operations, these modify the bitboard they're called on and
+ * return it so no new userdata is created.
+ */
+static int bitboard_ior(lua_State *L) {
+    U64 *bb1, *bb2;
+
+    bb1 = bitboard_checkmutable(L, 1);
+    bb2 = luaL_checkudata(L, 2, BITBOARD_T);
+
+    *bb1 |= *bb2;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bitboard_iand(lua_State *L) {
+    U64 *bb1, *bb2;
+
+    bb1 = bitboard_checkmutable(L, 1);
+    bb2 = luaL_checkudata(L, 2, BITBOARD_T);
+
+    *bb1 &= *bb2;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bitboard_ixor(lua_State *L) {
+    U64 *bb1, *bb2;
+
+    bb1 = bitboard_checkmutable(L, 1);
+    bb2 = luaL_checkudata(L, 2, BITBOARD_T);
+
+    *bb1 ^= *bb2;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bitboard_iandnot(lua_State *L) {
+    U64 *bb1, *bb2;
+
+    bb1 = bitboard_checkmutable(L, 1);
+    bb2 = luaL_checkudata(L, 2, BITBOARD_T);
+
+    *bb1 &= ~(*bb2);
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bitboard_ishl(lua_State *L) {
+    int bit;
+    U64 *bb;
+
+    bb = bitboard_checkmutable(L, 1);
+    bit = luaL_checkinteger(L, 2);
+
+    *bb = (bit < 0 || bit > 63) ? 0 : *bb << bit;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bitboard_ishr(lua_State *L) {
+    int bit;
+    U64 *bb;
+
+    bb = bitboard_checkmutable(L, 1);
+    bit = luaL_checkinteger(L, 2);
+
+    *bb = (bit < 0 || bit > 63) ? 0 : *bb >> bit;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int bitboard_inot(lua_State *L) {
+    U64 *bb;
+
+    bb = bitboard_checkmutable(L, 1);
+
+    *bb = ~(*bb);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/* Assigns another bitboard or a number to the bitboard. */
+static int bitboard_set(lua_State *L) {
+    U64 *bb;
+
+    bb = bitboard_checkmutable(L, 1);
+    if (LUA_TNUMBER == lua_type(L, 2))
+        *bb = bitboard_checknumber(L, 2);
+    else
+        *bb = *(U64 *)luaL_checkudata(L, 2, BITBOARD_T);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/* Fused operations, the result is written to the optional last argument
+ * which is returned, a new bitboard is created only if it's omitted.
+ */
+static U64 *check_out(lua_State *L, int narg) {
+    U64 *out;
+
+    if (!lua_isnoneornil(L, narg)) {
+        out = bitboard_checkmutable(L, narg);
+        lua_settop(L, narg);
+        return out;
+    }
+    lua_settop(L, narg - 1);
+    out = (U64 *)lua_newuserdata(L, sizeof(U64));
+    luaL_getmetatable(L, BITBOARD_T);
+    lua_setmetatable(L, -2);
+    return out;
+}
+
+/* bitboard.and_not(a, b, out) sets out to a & ~b */
+static int bitboard_and_not(lua_State *L) {
+    U64 a, b, *out;
+
+    a = *(U64 *)luaL_checkudata(L, 1, BITBOARD_T);
+    b = *(U64 *)luaL_checkudata(L, 2, BITBOARD_T);
+    out = check_out(L, 3);
+
+    *out = a & ~b;
+    return 1;
+}
+
+/* bitboard.or_and(a, b, c, out) sets out to (a | b) & c */
+static int bitboard_or_and(lua_State *L) {
+    U64 a, b, c, *out;
+
+    a = *(U64 *)luaL_checkudata(L, 1, BITBOARD_T);
+    b = *(U64 *)luaL_checkudata(L, 2, BITBOARD_T);
+    c = *(U64 *)luaL_checkudata(L, 3, BITBOARD_T);
+    out = check_out(L, 4);
+
+    *out = (a | b) & c;
+    return 1;
+}
+
+/* bitboard.and_and(a, b, c, out) sets out to a & b & c */
+static int bitboard_and_and(lua_State *L) {
+    U64 a, b, c, *out;
+
+    a = *(U64 *)luaL_checkudata(L, 1, BITBOARD_T);
+    b = *(U64 *)luaL_checkudata(L, 2, BITBOARD_T);
+    c = *(U64 *)luaL_checkudata(L, 3, BITBOARD_T);
+    out = check_out(L, 4);
+
+    *out = a & b & c;
+    return 1;
+}
+
 /* Miscallenous functions */
 static int bitboard_leadz(lua_State *L) {
     U64 *bb;
@@ -410,8 +648,54 @@ static int bitboard_trailz(lua_State *L) {
     return 1;
 }
 
+static int bitboard_popcount(lua_State *L) {
+    U64 *bb;
+
+    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    lua_pushinteger(L, popcount(*bb));
+    return 1;
+}
+
+/* Square scans, unlike leadz and trailz these use the square numbering where
+ * the rightmost bit is 0. They return nil if the bitboard is empty.
+ */
+static int bitboard_lsb(lua_State *L) {
+    U64 *bb;
+
+    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    if (0 == *bb)
+        return 0;
+    lua_pushinteger(L, bitscan(*bb));
+    return 1;
+}
+
+static int bitboard_msb(lua_State *L) {
+    U64 *bb;
+
+    bb = luaL_checkudata(L, 1, BITBOARD_T);
+    if (0 == *bb)
+        return 0;
+    lua_pushinteger(L, bitscan_rev(*bb));
+    return 1;
+}
+
+/* Clears the least significant one bit and returns its index. */
+static int bitboard_poplsb(lua_State *L) {
+    U64 *bb;
+
+    bb = bitboard_checkmutable(L, 1);
+    if (0 == *bb)
+        return 0;
+    lua_pushinteger(L, bitscan(*bb));
+    *bb &= *bb - 1;
+    return 1;
+}
+
 static const struct luaL_reg bblib_global[] = {
     {"bb", bitboard_new},
+    {"and_not", bitboard_and_not},
+    {"or_and", bitboard_or_and},
+    {"and_and", bitboard_and_and},
     {NULL, NULL}
 };
 
@@ -429,6 +713,15 @@ static const struct luaL_reg bblib_bitboard[] = {
     {"__tostring", bitboard_tostring},
 #endif
     {"copy", bitboard_copy},
+    {"set", bitboard_set},
+    {"ior", bitboard_ior},
+    {"iand", bitboard_iand},
+    {"ixor", bitboard_ixor},
+    {"iandnot", bitboard_iandnot},
+    {"ishl", bitboard_ishl},
+    {"ishr", bitboard_ishr},
+    {"inot", bitboard_inot},
+    {"tokey", bitboard_tokey},
     {"setbit", bitboard_setbit},
     {"setbit63", bitboard_setbit63},
     {"clrbit", bitboard_clrbit},
@@ -437,11 +730,19 @@ static const struct luaL_reg bblib_bitboard[] = {
     {"tstbit", bitboard_tstbit},
     {"leadz", bitboard_leadz},
     {"trailz", bitboard_trailz},
+    {"popcount", bitboard_popcount},
+    {"lsb", bitboard_lsb},
+    {"msb", bitboard_msb},
+    {"poplsb", bitboard_poplsb},
     {NULL, NULL}
 };
 
 LUALIB_API int luaopen_chess_bitboard(lua_State *L) {
-    init_lz_array();
+#ifndef HAVE_BUILTIN_CLZLL
+    static ONCE_T lz_once = ONCE_INIT;
+
+    run_once(&lz_once, init_lz_array);
+#endif /* !HAVE_BUILTIN_CLZLL */
     luaL_register(L, "chess.bitboard", bblib_global);
 
     /* Push version */
@@ -467,13 +768,47 @@ LUALIB_API int luaopen_chess_bitboard(lua_State *L) {
 #endif /* HAVE_STRTOULL */
     lua_settable(L, -3);
 
+    /* Push HAVE_BUILTIN_* */
+    lua_pushliteral(L, "_HAVE_BUILTIN_CLZLL");
+#ifdef HAVE_BUILTIN_CLZLL
+    lua_pushboolean(L, 1);
+#else
+    lua_pushboolean(L, 0);
+#endif /* HAVE_BUILTIN_CLZLL */
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "_HAVE_BUILTIN_CTZLL");
+#ifdef HAVE_BUILTIN_CTZLL
+    lua_pushboolean(L, 1);
+#else
+    lua_pushboolean(L, 0);
+#endif /* HAVE_BUILTIN_CTZLL */
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "_HAVE_BUILTIN_POPCOUNTLL");
+#ifdef HAVE_BUILTIN_POPCOUNTLL
+    lua_pushboolean(L, 1);
+#else
+    lua_pushboolean(L, 0);
+#endif /* HAVE_BUILTIN_POPCOUNTLL */
+    lua_settable(L, -3);
+
     /* Register BITBOARD_T metatable */
     luaL_newmetatable(L, BITBOARD_T);
     luaL_register(L, NULL, bblib_bitboard);
+    lua_pushliteral(L, "squares");
+    lua_pushcfunction(L, bitboard_squares_next);
+    lua_pushcclosure(L, bitboard_squares, 1);
+    lua_settable(L, -3);
     lua_pushstring(L, "__index");
     lua_pushvalue(L, -2); /* push the metatable */
     lua_settable(L, -3); /* metatable.__index = metatable */
 
+    /* Register chess.bitboard.array */
+    lua_pushvalue(L, -2); /* push the module table */
+    bbarray_open(L);
+    lua_pop(L, 1);
+
     return 1;
 }
 
@@ -30,6 +30,48 @@ typedef unsigned long long U64;
 #endif /* __64_BIT_INTEGER_DEFINED__ */
 
 #define BITBOARD_T "LuaChess.BitBoard"
+#define BITBOARD_ARRAY_T "LuaChess.BitBoardArray"
+
+/* Bitboards which are views of a board are read only, they're one byte longer
+ * than the others so the methods which change them in place can tell.
+ */
+#define BITBOARD_RO_SIZE (sizeof(U64) + 1)
+
+/* Bit scans and population count. The compiler builtins are used when
+ * they're available, they compile to single instructions with -mpopcnt,
+ * -mlzcnt and -mbmi (see WITH_HWBITS). Neither bitscan() nor bitscan_rev()
+ * may be called with zero.
+ */
+#ifdef HAVE_BUILTIN_CTZLL
+#define bitscan(bb) (__builtin_ctzll(bb))
+#else
+static const int bitscan_index64[64] = {
+     0,  1, 48,  2, 57, 49, 28,  3,
+    61, 58, 50, 42, 38, 29, 17,  4,
+    62, 55, 59, 36, 53, 51, 43, 22,
+    45, 39, 33, 30, 24, 18, 12,  5,
+    63, 47, 56, 27, 60, 41, 37, 16,
+    54, 35, 52, 21, 44, 32, 23, 11,
+    46, 26, 40, 15, 34, 20, 31, 10,
+    25, 14, 19,  9, 13,  8,  7,  6
+};
+
+/* Index of the least significant one bit using de Bruijn multiplication. */
+static inline int bitscan(U64 bb) {
+    return bitscan_index64[((bb & (~bb + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
+}
+#endif /* HAVE_BUILTIN_CTZLL */
+
+#ifdef HAVE_BUILTIN_POPCOUNTLL
+#define popcount(bb) (__builtin_popcountll(bb))
+#else
+static inline int popcount(U64 bb) {
+    bb = bb - ((bb >> 1) & 0x5555555555555555ULL);
+    bb = (bb & 0x3333333333333333ULL) + ((bb >> 2) & 0x3333333333333333ULL);
+    bb = (bb + (bb >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((bb * 0x0101010101010101ULL) >> 56);
+}
+#endif /* HAVE_BUILTIN_POPCOUNTLL */
 
 #ifdef HAVE_STRTOULL
 #define STRTOULL_DEFAULT_BASE 16
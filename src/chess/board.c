@@ -0,0 +1,802 @@
+/* Board module for LuaChess.
+ * requires the bitboard module.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *  based in part upon GNU Chess 5.0 which is
+ *  Copyright (c) 1999-2002 Free Software Foundation, Inc.
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h> /* for free, realloc */
+#include <string.h> /* for memset, strcmp */
+
+#include "lua.h"
+#include "lauxlib.h"
+
+#include "bitboard.h"
+#include "board.h"
+#include "magicmoves.h"
+#include "tables.h"
+
+/* Prototypes */
+LUALIB_API int luaopen_chess_board(lua_State *L);
+void db_open(lua_State *L); /* db.c */
+void posindex_open(lua_State *L); /* posindex.c */
+void book_open(lua_State *L); /* book.c */
+
+void board_clear(struct board *b) {
+    memset(b->pieces, 0, sizeof(b->pieces));
+    memset(b->occupied, 0, sizeof(b->occupied));
+    memset(b->cboard, 0, sizeof(b->cboard));
+    b->ep = -1;
+    b->flag = 0;
+    b->rhmc = 0;
+    b->fmc = 1;
+    b->hply = 0;
+    b->hgen++;
+    b->key = (BLACK == b->side) ? zobrist_side : 0;
+}
+
+/* Clears the castling flag of the rook on the given square. */
+static inline void clear_rook_flag(struct board *b, int sq, int side) {
+    if (WHITE == side) {
+        if ((b->flag & WKINGCASTLE) && sq == b->li_rook[0])
+            b->flag &= ~WKINGCASTLE;
+        else if ((b->flag & WQUEENCASTLE) && sq == b->li_rook[1])
+            b->flag &= ~WQUEENCASTLE;
+    }
+    else {
+        if ((b->flag & BKINGCASTLE) && sq == b->li_rook[0] + 56)
+            b->flag &= ~BKINGCASTLE;
+        else if ((b->flag & BQUEENCASTLE) && sq == b->li_rook[1] + 56)
+            b->flag &= ~BQUEENCASTLE;
+    }
+}
+
+/* Returns the initial and final squares of the rook for a castling move
+ * whose king lands on square t.
+ */
+static inline void castle_rook(const struct board *b, int t, int side, int *rl, int *rf) {
+    int base = (WHITE == side) ? 0 : 56;
+
+    if (FILE(t) == 6) { /* Castle kingside */
+        *rl = b->li_rook[0] + base;
+        *rf = base + 5;
+    }
+    else { /* Castle queenside */
+        *rl = b->li_rook[1] + base;
+        *rf = base + 3;
+    }
+}
+
+/* Doubles the capacity of the move history, returns -1 if there's no memory
+ * left, 0 otherwise. The history never shrinks.
+ */
+static int grow_history(struct board *b) {
+    int size;
+    struct undo *history;
+
+    size = b->hsize ? 2 * b->hsize : HISTORY_SIZE;
+    history = realloc(b->history, size * sizeof(struct undo));
+    if (NULL == history)
+        return -1;
+    b->history = history;
+    b->hsize = size;
+    return 0;
+}
+
+/* Makes the move, returns -1 if there's no piece on the origin square or the
+ * history can't grow, 0 otherwise.
+ */
+int board_make_move(struct board *b, int move) {
+    int f, t, fpiece, cpiece, side, xside, flag;
+    struct undo *u;
+
+    f = FROMSQ(move);
+    t = TOSQ(move);
+    fpiece = b->cboard[f];
+    if (0 == fpiece)
+        return -1;
+    if (b->hply == b->hsize && 0 != grow_history(b))
+        return -1;
+    side = b->side;
+    xside = XSIDE(side);
+    flag = b->flag;
+    if (move & CAPTURE)
+        cpiece = CAPTURE_PIECE(move);
+    else if (move & ENPASSANT)
+        cpiece = PAWN;
+    else
+        cpiece = 0;
+
+    u = &b->history[b->hply++];
+    b->hgen++;
+    u->key = b->key;
+    u->info = UNDO_PACK(move, cpiece, b->flag, b->ep, b->rhmc);
+
+    /* Clear pieces */
+    board_clear_piece(b, f, fpiece, side);
+    if (move & CAPTURE)
+        board_clear_piece(b, t, cpiece, xside);
+    else if (move & ENPASSANT)
+        board_clear_piece(b, (WHITE == side) ? t - 8 : t + 8, PAWN, xside);
+
+    /* Castling, the rook is lifted before the king is placed so that
+     * fischerandom castles where the king lands on the rook's square work.
+     */
+    if (move & CASTLING) {
+        int rl, rf;
+
+        castle_rook(b, t, side, &rl, &rf);
+        board_clear_piece(b, rl, ROOK, side);
+        board_set_piece(b, rf, ROOK, side);
+        /* Clear castling rights */
+        b->flag &= ~((WHITE == side) ? WCASTLE : BCASTLE);
+    }
+    else if (KING == fpiece) {
+        /* Clear castling rights */
+        b->flag &= ~((WHITE == side) ? WCASTLE : BCASTLE);
+    }
+
+    /* Set pieces */
+    if (move & PROMOTION)
+        board_set_piece(b, t, PROMOTE_PIECE(move), side);
+    else
+        board_set_piece(b, t, fpiece, side);
+
+    /* Clear the appropriate castling flag if a rook has moved. */
+    if (ROOK == fpiece)
+        clear_rook_flag(b, f, side);
+
+    /* Clear the appropriate castling flag if a rook has been captured. */
+    if (ROOK == cpiece)
+        clear_rook_flag(b, t, xside);
+    else if (KING == cpiece) /* only happens in some wild variants. */
+        b->flag &= ~((WHITE == side) ? WCASTLE : BCASTLE);
+
+    /* Castling flags were changed in place above, update the key. */
+    b->key ^= zobrist_flag[flag & 15] ^ zobrist_flag[b->flag & 15];
+
+    /* If pawn moved two squares set the enpassant square. */
+    if (PAWN == fpiece && (f - t == 16 || t - f == 16))
+        board_set_ep(b, (f + t) / 2);
+    else
+        board_set_ep(b, -1);
+
+    /* Update move counters */
+    if (PAWN == fpiece || (move & CAPTURE))
+        b->rhmc = 0;
+    else
+        b->rhmc++;
+    if (BLACK == side)
+        b->fmc++;
+
+    board_set_side(b, xside);
+    return 0;
+}
+
+/* Unmakes the last move, returns the move or -1 if no moves were made. The
+ * key and the state before the move are restored from the history.
+ */
+int board_unmake_move(struct board *b) {
+    int move, f, t, fpiece, cpiece, side, xside;
+    const struct undo *u;
+
+    if (0 == b->hply)
+        return -1;
+    u = &b->history[--b->hply];
+    b->hgen++;
+    move = UNDO_MOVE(u->info);
+    cpiece = UNDO_CAPTURED(u->info);
+    f = FROMSQ(move);
+    t = TOSQ(move);
+    fpiece = b->cboard[t];
+    /* If side is black, black is about to move, but we will be undoing a move
+     * by white, not black.
+     */
+    side = XSIDE(b->side);
+    xside = b->side;
+
+    board_take_piece(b, t, fpiece, side);
+
+    /* If castling, undo rook move */
+    if (move & CASTLING) {
+        int rl, rf;
+
+        castle_rook(b, t, side, &rl, &rf);
+        board_take_piece(b, rf, ROOK, side);
+        board_put_piece(b, rl, ROOK, side);
+    }
+
+    /* Undo promotion */
+    if (move & PROMOTION)
+        board_put_piece(b, f, PAWN, side);
+    else
+        board_put_piece(b, f, fpiece, side);
+
+    /* If capture, put back the captured piece */
+    if (move & ENPASSANT)
+        board_put_piece(b, (WHITE == side) ? t - 8 : t + 8, PAWN, xside);
+    else if (cpiece)
+        board_put_piece(b, t, cpiece, xside);
+
+    /* Restore castling flags, enpassant square, move counters and key */
+    b->flag = UNDO_FLAG(u->info);
+    b->ep = UNDO_EP(u->info);
+    b->rhmc = UNDO_RHMC(u->info);
+    if (BLACK == side)
+        b->fmc--;
+    b->side = side;
+    b->key = u->key;
+    return move;
+}
+
+/* Lua interface */
+static inline int check_square(lua_State *L, int narg) {
+    int sq;
+
+    sq = luaL_checkinteger(L, narg);
+    if (!SQUARE_ISVALID(sq))
+        luaL_argerror(L, narg, "invalid square");
+    return sq;
+}
+
+static inline int check_piece(lua_State *L, int narg) {
+    int piece;
+
+    piece = luaL_checkinteger(L, narg);
+    if (piece < PAWN || piece > KING)
+        luaL_argerror(L, narg, "invalid piece");
+    return piece;
+}
+
+static inline int check_side(lua_State *L, int narg) {
+    int side;
+
+    side = luaL_checkinteger(L, narg);
+    if (side != WHITE && side != BLACK)
+        luaL_argerror(L, narg, "invalid side");
+    return side;
+}
+
+static inline void push_bitboard(lua_State *L, U64 value) {
+    U64 *bb;
+
+    bb = (U64 *)lua_newuserdata(L, sizeof(U64));
+    luaL_getmetatable(L, BITBOARD_T);
+    lua_setmetatable(L, -2);
+    *bb = value;
+}
+
+/* Pushes a read only copy of one of the board's bitboards. */
+static inline void push_view(lua_State *L, U64 value) {
+    U64 *bb;
+
+    bb = (U64 *)lua_newuserdata(L, BITBOARD_RO_SIZE);
+    luaL_getmetatable(L, BITBOARD_T);
+    lua_setmetatable(L, -2);
+    *bb = value;
+}
+
+static int board_new(lua_State *L) {
+    struct board *b;
+
+    b = (struct board *)lua_newuserdata(L, sizeof(struct board));
+    b->hsize = 0;
+    b->history = NULL;
+    b->hgen = 0;
+    luaL_getmetatable(L, BOARD_T);
+    lua_setmetatable(L, -2);
+    if (0 != grow_history(b))
+        return luaL_error(L, "not enough memory");
+
+    b->side = WHITE;
+    board_clear(b);
+    b->li_king = 4; /* e1 */
+    b->li_rook[0] = 7; /* h1 */
+    b->li_rook[1] = 0; /* a1 */
+    return 1;
+}
+
+static int board_index(lua_State *L) {
+    const char *key;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+
+    /* Methods first */
+    lua_getmetatable(L, 1);
+    lua_pushvalue(L, 2);
+    lua_rawget(L, -2);
+    if (!lua_isnil(L, -1))
+        return 1;
+    lua_pop(L, 2);
+
+    if (LUA_TSTRING != lua_type(L, 2))
+        return 0;
+    key = lua_tostring(L, 2);
+    if (0 == strcmp(key, "side"))
+        lua_pushinteger(L, b->side);
+    else if (0 == strcmp(key, "ep"))
+        lua_pushinteger(L, b->ep);
+    else if (0 == strcmp(key, "flag"))
+        lua_pushinteger(L, b->flag);
+    else if (0 == strcmp(key, "rhmc"))
+        lua_pushinteger(L, b->rhmc);
+    else if (0 == strcmp(key, "fmc"))
+        lua_pushinteger(L, b->fmc);
+    else if (0 == strcmp(key, "li_king"))
+        lua_pushinteger(L, b->li_king);
+    else if (0 == strcmp(key, "key"))
+        push_bitboard(L, b->key);
+    else if (0 == strcmp(key, "hgen"))
+        lua_pushinteger(L, b->hgen);
+    else if (0 == strcmp(key, "li_rook")) {
+        lua_createtable(L, 2, 0);
+        lua_pushinteger(L, b->li_rook[0]);
+        lua_rawseti(L, -2, 1);
+        lua_pushinteger(L, b->li_rook[1]);
+        lua_rawseti(L, -2, 2);
+    }
+    else
+        return 0;
+    return 1;
+}
+
+static int board_newindex(lua_State *L) {
+    const char *key;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    key = luaL_checkstring(L, 2);
+    if (0 == strcmp(key, "side"))
+        board_set_side(b, check_side(L, 3));
+    else if (0 == strcmp(key, "ep")) {
+        int ep = luaL_checkinteger(L, 3);
+        if (ep != -1 && !SQUARE_ISVALID(ep))
+            return luaL_argerror(L, 3, "invalid en passant square");
+        board_set_ep(b, ep);
+    }
+    else if (0 == strcmp(key, "flag")) {
+        int flag = luaL_checkinteger(L, 3);
+        if (flag & ~(WCASTLE | BCASTLE))
+            return luaL_argerror(L, 3, "invalid castling flags");
+        board_set_flag(b, flag);
+    }
+    else if (0 == strcmp(key, "rhmc")) {
+        int rhmc = luaL_checkinteger(L, 3);
+        if (rhmc < 0 || rhmc > COUNTER_MAX)
+            return luaL_argerror(L, 3, "move counter out of range");
+        b->rhmc = rhmc;
+    }
+    else if (0 == strcmp(key, "fmc"))
+        b->fmc = luaL_checkinteger(L, 3);
+    else if (0 == strcmp(key, "li_king"))
+        b->li_king = check_square(L, 3);
+    else if (0 == strcmp(key, "li_rook")) {
+        luaL_checktype(L, 3, LUA_TTABLE);
+        lua_rawgeti(L, 3, 1);
+        lua_rawgeti(L, 3, 2);
+        b->li_rook[0] = check_square(L, -2);
+        b->li_rook[1] = check_square(L, -1);
+    }
+    else
+        return luaL_error(L, "invalid board field '%s'", key);
+    b->hgen++;
+    return 0;
+}
+
+static int board_set_piece_lua(lua_State *L) {
+    int sq, piece, side;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    sq = check_square(L, 2);
+    piece = check_piece(L, 3);
+    side = check_side(L, 4);
+
+    board_set_piece(b, sq, piece, side);
+    return 0;
+}
+
+static int board_clear_piece_lua(lua_State *L) {
+    int sq, piece, side;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    sq = check_square(L, 2);
+    piece = check_piece(L, 3);
+    side = check_side(L, 4);
+
+    board_clear_piece(b, sq, piece, side);
+    return 0;
+}
+
+static int board_get_piece(lua_State *L) {
+    int sq;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    sq = check_square(L, 2);
+
+    if (0 == b->cboard[sq]) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushinteger(L, b->cboard[sq]);
+    lua_pushinteger(L, board_side_at(b, sq));
+    return 2;
+}
+
+static int board_has_piece(lua_State *L) {
+    int sq;
+    U64 occ;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    sq = check_square(L, 2);
+    if (lua_isnoneornil(L, 3))
+        occ = b->occupied[OCC_ALL];
+    else
+        occ = b->occupied[check_side(L, 3) - 1];
+
+    lua_pushboolean(L, (occ & (1ULL << sq)) != 0);
+    return 1;
+}
+
+static int board_clear_all(lua_State *L) {
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    board_clear(b);
+    return 0;
+}
+
+static int board_occupied(lua_State *L) {
+    int i;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    i = luaL_checkinteger(L, 2);
+    if (i < 1 || i > 4)
+        return luaL_argerror(L, 2, "invalid index");
+
+    push_view(L, b->occupied[i - 1]);
+    return 1;
+}
+
+static int board_pieces(lua_State *L) {
+    int side, piece;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    side = check_side(L, 2);
+    piece = check_piece(L, 3);
+
+    push_view(L, b->pieces[side - 1][piece - 1]);
+    return 1;
+}
+
+static int board_piece_at(lua_State *L) {
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    lua_pushinteger(L, b->cboard[check_square(L, 2)]);
+    return 1;
+}
+
+/* b:loadfen(fen) returns true or nil, an error message and the 1-based
+ * offset of the offending byte.
+ */
+static int board_loadfen_lua(lua_State *L) {
+    size_t len, errpos;
+    const char *fen, *errmsg;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    fen = luaL_checklstring(L, 2, &len);
+
+    if (0 != board_loadfen(b, fen, len, &errpos, &errmsg)) {
+        lua_pushnil(L);
+        lua_pushstring(L, errmsg);
+        lua_pushinteger(L, errpos + 1);
+        return 3;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int board_fen_lua(lua_State *L) {
+    size_t len;
+    char buf[FEN_MAX];
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    len = board_fen(b, buf);
+    lua_pushlstring(L, buf, len);
+    return 1;
+}
+
+/* b:parse_san(san) returns the legal move san describes or nil and an error
+ * message.
+ */
+static int board_parse_san_lua(lua_State *L) {
+    int move;
+    size_t len;
+    const char *san, *errmsg;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    san = luaL_checklstring(L, 2, &len);
+
+    if (0 == (move = board_parse_san(b, san, len, &errmsg))) {
+        lua_pushnil(L);
+        lua_pushstring(L, errmsg);
+        return 2;
+    }
+    lua_pushinteger(L, move);
+    return 1;
+}
+
+static int board_make_move_lua(lua_State *L) {
+    int move;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    move = luaL_checkinteger(L, 2);
+
+    if (0 != board_make_move(b, move)) {
+        if (0 != b->cboard[FROMSQ(move)])
+            return luaL_error(L, "not enough memory");
+        return luaL_argerror(L, 2, "no piece on the origin square");
+    }
+    lua_pushinteger(L, move);
+    return 1;
+}
+
+static int board_unmake_move_lua(lua_State *L) {
+    int move;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+
+    move = board_unmake_move(b);
+    if (-1 == move)
+        return luaL_error(L, "no moves made yet");
+    lua_pushinteger(L, move);
+    return 1;
+}
+
+/* Returns the move history as a table of {move, flag, ep, rhmc} entries where
+ * flag, ep and rhmc are the values after the move has been made. The first
+ * entry is always a NULLMOVE holding the initial values.
+ */
+static int board_history(lua_State *L) {
+    int i;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+
+    lua_createtable(L, b->hply ? b->hply + 1 : 0, 0);
+    for (i = 0; i < b->hply; i++) {
+        const struct undo *u = &b->history[i];
+        const struct undo *next = (i + 1 < b->hply) ? &b->history[i + 1] : NULL;
+
+        if (0 == i) {
+            lua_createtable(L, 4, 0);
+            lua_pushinteger(L, NULLMOVE);
+            lua_rawseti(L, -2, 1);
+            lua_pushinteger(L, UNDO_FLAG(u->info));
+            lua_rawseti(L, -2, 2);
+            lua_pushinteger(L, UNDO_EP(u->info));
+            lua_rawseti(L, -2, 3);
+            lua_pushinteger(L, UNDO_RHMC(u->info));
+            lua_rawseti(L, -2, 4);
+            lua_rawseti(L, -2, 1);
+        }
+
+        lua_createtable(L, 4, 0);
+        lua_pushinteger(L, UNDO_MOVE(u->info));
+        lua_rawseti(L, -2, 1);
+        lua_pushinteger(L, next ? UNDO_FLAG(next->info) : b->flag);
+        lua_rawseti(L, -2, 2);
+        lua_pushinteger(L, next ? UNDO_EP(next->info) : b->ep);
+        lua_rawseti(L, -2, 3);
+        lua_pushinteger(L, next ? UNDO_RHMC(next->info) : b->rhmc);
+        lua_rawseti(L, -2, 4);
+        lua_rawseti(L, -2, i + 2);
+    }
+    return 1;
+}
+
+static int push_moves(lua_State *L, int legal) {
+    int i, n;
+    int moves[MAX_MOVES];
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+
+    n = board_generate(b, moves, MAX_MOVES, legal);
+    lua_createtable(L, n, 0);
+    for (i = 0; i < n; i++) {
+        lua_pushinteger(L, moves[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+static int board_legal_moves(lua_State *L) {
+    return push_moves(L, 1);
+}
+
+static int board_pseudo_moves(lua_State *L) {
+    return push_moves(L, 0);
+}
+
+static int board_in_check_lua(lua_State *L) {
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+
+    lua_pushboolean(L, board_in_check(b));
+    return 1;
+}
+
+static inline int check_depth(lua_State *L, int narg) {
+    int depth;
+
+    depth = luaL_checkinteger(L, narg);
+    if (depth < 0 || depth > MAX_DEPTH)
+        luaL_argerror(L, narg, "invalid depth");
+    return depth;
+}
+
+static int board_perft_lua(lua_State *L) {
+    int depth;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    depth = check_depth(L, 2);
+
+    lua_pushnumber(L, (lua_Number)board_perft(b, depth));
+    return 1;
+}
+
+/* Returns a table mapping each legal move to the number of leaf nodes below
+ * it, and the total number of nodes.
+ */
+static int board_divide(lua_State *L) {
+    int i, n, depth;
+    int moves[MAX_MOVES];
+    U64 nodes, total;
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    depth = check_depth(L, 2);
+    if (depth < 1)
+        return luaL_argerror(L, 2, "invalid depth");
+
+    n = board_generate(b, moves, MAX_MOVES, 1);
+    total = 0;
+    lua_createtable(L, 0, n);
+    for (i = 0; i < n; i++) {
+        board_make_move(b, moves[i]);
+        nodes = board_perft(b, depth - 1);
+        board_unmake_move(b);
+        total += nodes;
+        lua_pushinteger(L, moves[i]);
+        lua_pushnumber(L, (lua_Number)nodes);
+        lua_rawset(L, -3);
+    }
+    lua_pushnumber(L, (lua_Number)total);
+    return 2;
+}
+
+static const struct luaL_reg board_global[] = {
+    {"new", board_new},
+    {NULL, NULL}
+};
+
+static int board_gc(lua_State *L) {
+    struct board *b;
+
+    b = luaL_checkudata(L, 1, BOARD_T);
+    free(b->history);
+    b->history = NULL;
+    b->hsize = 0;
+    return 0;
+}
+
+static const struct luaL_reg board_methods[] = {
+    {"__gc", board_gc},
+    {"__index", board_index},
+    {"__newindex", board_newindex},
+    {"set_piece", board_set_piece_lua},
+    {"clear_piece", board_clear_piece_lua},
+    {"get_piece", board_get_piece},
+    {"has_piece", board_has_piece},
+    {"clear_all", board_clear_all},
+    {"occupied", board_occupied},
+    {"pieces", board_pieces},
+    {"piece_at", board_piece_at},
+    {"loadfen", board_loadfen_lua},
+    {"fen", board_fen_lua},
+    {"parse_san", board_parse_san_lua},
+    {"make_move", board_make_move_lua},
+    {"unmake_move", board_unmake_move_lua},
+    {"history", board_history},
+    {"legal_moves", board_legal_moves},
+    {"pseudo_moves", board_pseudo_moves},
+    {"in_check", board_in_check_lua},
+    {"perft", board_perft_lua},
+    {"divide", board_divide},
+    {NULL, NULL}
+};
+
+LUALIB_API int luaopen_chess_board(lua_State *L) {
+    int inits;
+
+    if (!MAGICMOVES_SUPPORTED())
+        return luaL_error(L, "the " MAGICMOVES_LAYOUT " slider tables aren't supported by this CPU");
+    inits = tables_setup();
+    luaL_register(L, "chess.board", board_global);
+
+    /* Push version */
+    lua_pushliteral(L, "_VERSION");
+    lua_pushstring(L, PACKAGE_NAME "-" VERSION);
+    lua_settable(L, -3);
+
+    /* Push the layout and size of the slider lookup tables */
+    lua_pushliteral(L, "_MAGIC");
+    lua_pushliteral(L, MAGICMOVES_LAYOUT);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "_MAGIC_SIZE");
+    lua_pushinteger(L, MAGICMOVES_SIZE);
+    lua_settable(L, -3);
+
+    /* Push how many times the tables were built, once per process, and where
+     * they are
+     */
+    lua_pushliteral(L, "_INITS");
+    lua_pushinteger(L, inits);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "_TABLES");
+    lua_pushlightuserdata(L, RAYS);
+    lua_settable(L, -3);
+
+    /* Push MAX_DEPTH */
+    lua_pushliteral(L, "MAX_DEPTH");
+    lua_pushinteger(L, MAX_DEPTH);
+    lua_settable(L, -3);
+
+    /* Push MAX_MOVES */
+    lua_pushliteral(L, "MAX_MOVES");
+    lua_pushinteger(L, MAX_MOVES);
+    lua_settable(L, -3);
+
+    /* Register BOARD_T metatable */
+    luaL_newmetatable(L, BOARD_T);
+    luaL_register(L, NULL, board_methods);
+    lua_pop(L, 1);
+
+    db_open(L);
+    posindex_open(L);
+    book_open(L);
+
+    return 1;
+}
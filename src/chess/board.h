@@ -0,0 +1,243 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *  based in part upon GNU Chess 5.0 which is
+ *  Copyright (c) 1999-2002 Free Software Foundation, Inc.
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LUACHESS_GUARD_BOARD_H
+#define LUACHESS_GUARD_BOARD_H 1
+
+#include <stddef.h> /* for size_t */
+
+#include "bitboard.h"
+#include "zobrist.h"
+
+#define BOARD_T "LuaChess.Board"
+
+/* Sides */
+#define WHITE 1
+#define BLACK 2
+#define NOCOLOUR 3
+#define XSIDE(side) ((side) ^ 3)
+
+/* Pieces */
+#define PAWN 1
+#define KNIGHT 2
+#define BISHOP 3
+#define ROOK 4
+#define QUEEN 5
+#define KING 6
+
+/* Move description, keep in sync with chess.lua */
+#define KNIGHTPRM 0x00002000
+#define BISHOPPRM 0x00003000
+#define ROOKPRM   0x00004000
+#define QUEENPRM  0x00005000
+#define KINGPRM   0x00006000 /* Possible in suicide */
+#define PROMOTION 0x00007000
+#define PAWNCAP   0x00008000
+#define KNIGHTCAP 0x00010000
+#define BISHOPCAP 0x00018000
+#define ROOKCAP   0x00020000
+#define QUEENCAP  0x00028000
+#define KINGCAP   0x00030000 /* Possible in suicide and giveaway */
+#define CAPTURE   0x00038000
+#define NULLMOVE  0x00100000
+#define CASTLING  0x00200000
+#define ENPASSANT 0x00400000
+
+#define TOSQ(move) ((move) & 0x003F)
+#define FROMSQ(move) (((move) >> 6) & 0x003F)
+#define MOVE(from, to) (((from) << 6) | (to))
+#define CAPTURE_PIECE(move) (((move) >> 15) & 0x0007)
+#define PROMOTE_PIECE(move) (((move) >> 12) & 0x0007)
+
+/* Castling flags */
+#define WKINGCASTLE 0x0001
+#define WQUEENCASTLE 0x0002
+#define BKINGCASTLE 0x0004
+#define BQUEENCASTLE 0x0008
+#define WCASTLE (WKINGCASTLE | WQUEENCASTLE)
+#define BCASTLE (BKINGCASTLE | BQUEENCASTLE)
+
+/* Squares */
+#define RANK(sq) ((sq) >> 3)
+#define FILE(sq) ((sq) & 7)
+#define SQUARE_ISVALID(sq) ((sq) >= 0 && (sq) < 64)
+
+/* Indexes of board.occupied */
+#define OCC_ALL 2
+#define OCC_EMPTY 3
+
+/* Initial capacity of the move history, it's doubled whenever it fills up. */
+#define HISTORY_SIZE 256
+
+/* Maximum perft depth. */
+#define MAX_DEPTH 64
+
+/* Maximum number of moves in a position, set_piece() may build any position so
+ * this is 64 pieces with 27 targets each, the most a queen has.
+ */
+#define MAX_MOVES (64 * 27)
+
+/* Largest move counter loadfen or the rhmc field accept, the undo records have
+ * room for more.
+ */
+#define COUNTER_MAX 0xFFFFFF
+
+/* Room needed for the longest FEN board_fen() may write. */
+#define FEN_MAX 128
+
+/* Information needed to unmake a move: the key before the move and the move,
+ * captured piece, castling flags, en passant square and reversible half move
+ * counter before the move packed into one word.
+ */
+struct undo {
+    U64 key;
+    U64 info;
+};
+
+#define UNDO_PACK(move, cpiece, flag, ep, rhmc) \
+    ((U64)(move) | ((U64)(cpiece) << 23) | ((U64)((flag) & 15) << 26) \
+     | ((U64)((ep) + 1) << 30) | ((U64)(rhmc) << 37))
+#define UNDO_MOVE(info) ((int)((info) & 0x7FFFFF))
+#define UNDO_CAPTURED(info) ((int)(((info) >> 23) & 7))
+#define UNDO_FLAG(info) ((int)(((info) >> 26) & 15))
+#define UNDO_EP(info) ((int)(((info) >> 30) & 127) - 1)
+#define UNDO_RHMC(info) ((int)((info) >> 37))
+
+/* The position is kept in one block so that make/unmake never leave C. */
+struct board {
+    /* Pieces, first row is white pieces (0=pawn,5=king),
+     * second row is black pieces.
+     */
+    U64 pieces[2][6];
+    /* Occupied squares.
+     * First is white, second is black, third is all, fourth is empty.
+     */
+    U64 occupied[4];
+    /* cboard[sq] gives the piece on square sq, 0 if empty. */
+    unsigned char cboard[64];
+    int side;
+    int ep;
+    /* Castling flags */
+    int flag;
+    /* Initial locations for white king and white rooks.
+     * This is needed to implement fischerandom castling easily.
+     */
+    int li_king;
+    int li_rook[2];
+    /* Move counts */
+    int rhmc; /* reversible half move counter */
+    int fmc; /* full move counter */
+    /* Move history, hsize records are allocated. */
+    int hply;
+    int hsize;
+    struct undo *history;
+    /* Changed whenever the history or the state it records for the last
+     * position changes, so views of it can be cached.
+     */
+    unsigned int hgen;
+    /* Zobrist key, kept up to date by the functions below. */
+    U64 key;
+};
+
+/* These two leave the key alone, unmaking a move restores it in one go. */
+static inline void board_put_piece(struct board *b, int sq, int piece, int side) {
+    U64 bit = 1ULL << sq;
+
+    b->pieces[side - 1][piece - 1] |= bit;
+    b->occupied[side - 1] |= bit;
+    b->occupied[OCC_ALL] |= bit;
+    b->occupied[OCC_EMPTY] &= ~bit;
+    b->cboard[sq] = piece;
+}
+
+static inline void board_take_piece(struct board *b, int sq, int piece, int side) {
+    U64 bit = 1ULL << sq;
+
+    b->pieces[side - 1][piece - 1] &= ~bit;
+    b->occupied[side - 1] &= ~bit;
+    b->occupied[OCC_ALL] &= ~bit;
+    b->occupied[OCC_EMPTY] |= bit;
+    b->cboard[sq] = 0;
+}
+
+static inline void board_set_piece(struct board *b, int sq, int piece, int side) {
+    board_put_piece(b, sq, piece, side);
+    b->key ^= zobrist_piece[side - 1][piece - 1][sq];
+}
+
+static inline void board_clear_piece(struct board *b, int sq, int piece, int side) {
+    board_take_piece(b, sq, piece, side);
+    b->key ^= zobrist_piece[side - 1][piece - 1][sq];
+}
+
+static inline void board_set_side(struct board *b, int side) {
+    if (side != b->side)
+        b->key ^= zobrist_side;
+    b->side = side;
+}
+
+static inline void board_set_flag(struct board *b, int flag) {
+    b->key ^= zobrist_flag[b->flag & 15] ^ zobrist_flag[flag & 15];
+    b->flag = flag;
+}
+
+static inline void board_set_ep(struct board *b, int ep) {
+    if (-1 != b->ep)
+        b->key ^= zobrist_ep[FILE(b->ep)];
+    if (-1 != ep)
+        b->key ^= zobrist_ep[FILE(ep)];
+    b->ep = ep;
+}
+
+static inline int board_side_at(const struct board *b, int sq) {
+    return (b->occupied[0] & (1ULL << sq)) ? WHITE : BLACK;
+}
+
+/* Returns 1 if move is one of the n moves board_generate() wrote, 0 otherwise. */
+static inline int board_has_move(const int *moves, int n, int move) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (moves[i] == move)
+            return 1;
+    }
+    return 0;
+}
+
+void board_clear(struct board *b);
+int board_make_move(struct board *b, int move);
+int board_unmake_move(struct board *b);
+
+/* movegen.c */
+int board_in_check(const struct board *b);
+int board_generate(const struct board *b, int *moves, int size, int legal);
+U64 board_perft(struct board *b, int depth);
+
+/* fen.c */
+int board_loadfen(struct board *b, const char *fen, size_t len,
+        size_t *errpos, const char **errmsg);
+size_t board_fen(const struct board *b, char *buf);
+
+/* san.c */
+int board_parse_san(const struct board *b, const char *san, size_t len,
+        const char **errmsg);
+
+#endif /* LUACHESS_GUARD_BOARD_H */
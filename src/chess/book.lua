@@ -0,0 +1,55 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Opening book module for LuaChess
+-- Reads Polyglot books. The book is mapped into memory and searched in place,
+-- probing it allocates nothing when the arrays are reused, so it's cheap
+-- enough to do for every position of a game.
+
+--{{{Grab environment
+local chessboard = require "chess.board"
+--}}}
+
+module "chess.book"
+
+--- Opens a Polyglot book.<br />
+-- The book userdata has the methods:
+-- <ul>
+-- <li>moves(board, moves, weights), returns arrays of the legal book moves of
+-- the position in the format of chess.MOVE() and of their weights. If the
+-- arrays are given they're filled in place.</li>
+-- <li>pick(board, r), returns a legal book move and its weight or nothing.
+-- If r in [0, 1) is given, e.g. math.random(), moves are picked with
+-- probabilities proportional to their weights, otherwise the heaviest move
+-- is returned. Moves of weight 0 are never picked.</li>
+-- <li>count(), also #book, returns the number of entries.</li>
+-- <li>close()</li>
+-- </ul>
+-- The board is a chess.Board or its core.
+-- @param filename Name of the book file.
+-- @return book userdata or nil and an error message.
+function open(filename)
+    return chessboard.openbook(filename)
+end
+
+--- Returns the Polyglot key of a position as a bitboard.<br />
+-- The en passant file only counts if a pawn of the side to move can capture,
+-- so the key differs from board.key.
+function key(board)
+    return chessboard.book_key(board)
+end
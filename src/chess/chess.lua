@@ -25,6 +25,7 @@
 -- Builtin functions
 local assert = assert
 local error = error
+local ipairs = ipairs
 local setmetatable = setmetatable
 local tonumber = tonumber
 local type = type
@@ -45,9 +46,11 @@ local bit = require "bit"
 -- Internal modules
 require "chess.bitboard"
 require "chess.attack"
+require "chess.board"
 require "chess.move"
 local bitboard = chess.bitboard
 local attack = chess.attack
+local chessboard = chess.board
 local move = chess.move
 --}}}
 --{{{Shortcuts to module functions
@@ -55,6 +58,9 @@ local band, bnot, bor, bxor, lshift, rshift = bit.band, bit.bnot, bit.bor, bit.b
     bit.lshift, bit.rshift
 local bb = bitboard.bb
 local atak = attack.atak
+local attackers_to = attack.attackers_to
+local attacked_by = attack.attacked_by
+local see = attack.see
 --}}}
 module "chess"
 _VERSION = bitboard._VERSION
@@ -196,6 +202,20 @@ WCASTLE = bor(WKINGCASTLE, WQUEENCASTLE)
 BCASTLE = bor(BKINGCASTLE, BQUEENCASTLE)
 --}}}
 --{{{Board
+-- Returns a table mapping occupied squares to their FEN piece letters, only
+-- the occupied squares are visited.
+local function piece_chars(board)
+    local chars = {}
+    for side=WHITE,BLACK do
+        for sq in board.bitboard.occupied[side]:squares() do
+            chars[sq] = piece_tostring(board.core:piece_at(sq), side)
+        end
+    end
+    return chars
+end
+-- Fields of Board which are stored in the chess.board object.
+local board_fields = {side = true, ep = true, flag = true, li_king = true,
+    li_rook = true, rhmc = true, fmc = true}
 Board = setmetatable({}, {
     __call = function (self, argtable)
         assert(type(argtable) == "table", "argument not a table")
@@ -223,56 +243,75 @@ Board = setmetatable({}, {
             argtable.fmc = assert(tonumber(argtable.fmc), "fmove not a number")
         end
 
+        -- The position itself lives in a chess.board object, the fields below
+        -- are views of it kept for compatibility.
+        local core = chessboard.new()
+        core.side = argtable.side or WHITE
+        core.ep = argtable.ep or -1
+        -- Castling flags
+        core.flag = argtable.flag or 0
+        -- Initial locations for white rooks and white king.
+        -- This is needed to implement fischerandom castling easily.
+        core.li_king = argtable.li_king or squarei"e1"
+        core.li_rook = argtable.li_rook or {squarei"h1", squarei"a1"}
+        -- Move counts
+        core.rhmc = argtable.rhmc or 0 -- reversible half move counter
+        core.fmc = argtable.fmc or 1 -- full move counter
+
+        -- The views are read only, as are the bitboards they return, the
+        -- position is changed with set_piece(), clear_piece() and the moves.
+        local function readonly(t, key)
+            error("read only view of the board, use set_piece() or clear_piece()", 2)
+        end
+        local pieces = {}
+        for side=WHITE,BLACK do
+            pieces[side] = setmetatable({}, {__index = function (_, piece)
+                return core:pieces(side, piece) end, __newindex = readonly})
+        end
+        local bitboard = {
+            -- Occupied squares
+            -- First is white, second is black, third is all, fourth is empty.
+            occupied = setmetatable({}, {__index = function (_, i)
+                return core:occupied(i) end, __newindex = readonly}),
+            -- Pieces, first table is white pieces (1=pawn,6=king),
+            -- second table is black pieces.
+            pieces = setmetatable({}, {__index = pieces, __newindex = readonly}),
+        }
         local board = {
-            bitboard = {
-                -- Occupied squares
-                -- First is white, second is black, third is all, fourth is empty.
-                occupied = {bb(0), bb(0), bb(0), bb(0)},
-                -- Pieces, first table is white pieces (1=pawn,6=king),
-                -- second table is black pieces.
-                pieces = {
-                    {bb(0), bb(0), bb(0), bb(0), bb(0), bb(0)},
-                    {bb(0), bb(0), bb(0), bb(0), bb(0), bb(0)},
-                },
-            },
+            core = core,
+            bitboard = setmetatable({}, {__index = bitboard,
+                __newindex = readonly}),
             -- cboard[sq+1] gives the piece on square sq.
-            cboard = {
-                0, 0, 0, 0, 0, 0, 0, 0,
-                0, 0, 0, 0, 0, 0, 0, 0,
-                0, 0, 0, 0, 0, 0, 0, 0,
-                0, 0, 0, 0, 0, 0, 0, 0,
-                0, 0, 0, 0, 0, 0, 0, 0,
-                0, 0, 0, 0, 0, 0, 0, 0,
-                0, 0, 0, 0, 0, 0, 0, 0,
-                0, 0, 0, 0, 0, 0, 0, 0,
-            },
-            side = argtable.side or WHITE,
-            ep = argtable.ep or -1,
-            -- Castling flags
-            flag = argtable.flag or 0,
-            -- Initial locations for white rooks and white king.
-            -- This is needed to implement fischerandom castling easily.
-            li_king = argtable.li_king or squarei"e1",
-            li_rook = argtable.li_rook or {squarei"h1", squarei"a1"},
-            -- Move counts
-            rhmc = argtable.rhmc or 0, -- reversible half move counter
-            fmc = argtable.fmc or 1, -- full move counter
-            -- Move list
-            movelist = {},
+            cboard = setmetatable({}, {__index = function (_, i)
+                return core:piece_at(i - 1) end, __newindex = readonly}),
         }
-        return setmetatable(board, {__index = self,
+        -- The move list is rebuilt only when the history changes.
+        local movelist, movelist_hgen
+        return setmetatable(board, {
+        __index = function (board, key)
+            local method = self[key]
+            if method ~= nil then return method end
+            if key == "movelist" then
+                local hgen = core.hgen
+                if hgen ~= movelist_hgen then
+                    movelist, movelist_hgen = core:history(), hgen
+                end
+                return movelist
+            end
+            return core[key]
+        end,
+        __newindex = function (board, key, value)
+            if board_fields[key] then core[key] = value
+            elseif key == "movelist" then readonly()
+            else rawset(board, key, value) end
+        end,
         __tostring = function (board) --{{{
+                local chars = piece_chars(board)
                 local s = "  a b c d e f g h"
                 for rank=8,1,-1 do
                     s = s .. "\n" .. rank .. " "
-                    for file=string.byte"a",string.byte"h" do
-                        local sq = string.char(file) .. rank
-                        local piece, side = board:get_piece(squarei(sq))
-                        if not piece then
-                            s = s .. "-" .. " "
-                        else
-                            s = s .. piece_tostring(piece, side) .. " "
-                        end
+                    for sq=(rank - 1) * 8,(rank - 1) * 8 + 7 do
+                        s = s .. (chars[sq] or "-") .. " "
                     end
 
                     if rank == 8 then
@@ -321,319 +360,33 @@ Board = setmetatable({}, {
     end
     })
 function Board:set_piece(square, piece, side) --{{{
-    assert(square > -1 and square < 64, "invalid square")
-    assert(piece >= PAWN and piece <= KING, "invalid piece")
-    assert(side == WHITE or side == BLACK, "invalid side")
-    self.bitboard.pieces[side][piece]:setbit(square)
-    self.bitboard.occupied[side]:setbit(square)
-    self.bitboard.occupied[3]:setbit(square)
-    self.bitboard.occupied[4]:clrbit(square)
-    self.cboard[square + 1] = piece
+    return self.core:set_piece(square, piece, side)
 end --}}}
 function Board:get_piece(square) --{{{
-    assert(square > -1 and square < 64, "invalid square")
-    local piece = self.cboard[square + 1]
-    if piece == 0 then return nil end
-    if self.bitboard.pieces[WHITE][piece]:tstbit(square) then
-        return piece, WHITE
-    end
-    return piece, BLACK
+    return self.core:get_piece(square)
 end --}}}
 function Board:clear_piece(square, piece, side) --{{{
-    assert(square > -1 and square < 64, "invalid square")
-    assert(piece >= PAWN and piece <= KING, "invalid piece")
-    assert(side == WHITE or side == BLACK, "invalid side")
-    self.bitboard.pieces[side][piece]:clrbit(square)
-    self.bitboard.occupied[side]:clrbit(square)
-    self.bitboard.occupied[3]:clrbit(square)
-    self.bitboard.occupied[4]:setbit(square)
-    self.cboard[square + 1] = 0
+    return self.core:clear_piece(square, piece, side)
 end --}}}
 function Board:clear_all() --{{{
-    self.bitboard.occupied = {bb(0), bb(0), bb(0), bb(0)}
-    self.bitboard.pieces = {
-        {bb(0), bb(0), bb(0), bb(0), bb(0), bb(0)},
-        {bb(0), bb(0), bb(0), bb(0), bb(0), bb(0)},
-    }
-    self.cboard = {
-        0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0,
-    }
-    self.ep = -1
-    self.flag = 0
-    self.rhmc = 0
-    self.fmc = 1
-    self.movelist = {}
+    return self.core:clear_all()
 end --}}}
 function Board:has_piece(square, side) --{{{
-    assert(square > -1 and square < 64, "invalid square")
-    assert(not side or side == WHITE or side == BLACK, "invalid side")
-    if not side then return self.bitboard.occupied[3]:tstbit(square)
-    else return self.bitboard.occupied[side]:tstbit(square) end
+    return self.core:has_piece(square, side)
 end --}}}
 function Board:fen() --{{{
-    local fen = ""
-    for r=8,1,-1 do
-        local rank = ""
-        local empty_count = 0
-        for f=1,8 do
-            local square = squarei(string.char(f + 96) .. r)
-            local piece, side = self:get_piece(square)
-            if not piece then
-                empty_count = empty_count + 1
-            else
-                if empty_count > 0 then
-                    rank = rank .. empty_count
-                    empty_count = 0
-                end
-                rank = rank .. piece_tostring(piece, side)
-            end
-        end
-        if empty_count > 0 then rank = rank .. empty_count end
-        fen = fen .. rank
-        if r ~= 1 then fen = fen .. "/" end
-    end
-
-    -- Side to move
-    if self.side == WHITE then fen = fen .. " w"
-    else fen = fen .. " b" end
-
-    -- Castling rights
-    local crights = ""
-    if tstbit(self.flag, WKINGCASTLE) then crights = crights .. "K" end
-    if tstbit(self.flag, WQUEENCASTLE) then crights = crights .. "Q" end
-    if tstbit(self.flag, BKINGCASTLE) then crights = crights .. "k" end
-    if tstbit(self.flag, BQUEENCASTLE) then crights = crights .. "q" end
-    if crights == "" then crights = "-" end
-    fen = fen .. " " .. crights
-
-    -- En passant square
-    if self.ep == -1 then fen = fen .. " -"
-    else fen = fen .. " " .. squarec(self.ep) end
-
-    -- Move counters
-    fen = fen .. " " .. self.rhmc .. " " .. self.fmc
-
-    return fen
+    return self.core:fen()
 end --}}}
 function Board:loadfen(fen) --{{{
-    fen = fen or "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
-    local pieces, side, castles, ep, rhmc, fmc = move.fen:match(fen)
-    assert(pieces and side and castles and ep and rhmc and fmc, "invalid fen")
-
-    -- Set the pieces
-    self:clear_all()
-    local sq = 63
-    for _, element in pieces() do
-        if type(element) == "number" then
-            sq = sq - element
-        else
-            self:set_piece(sq, element[1], element[2])
-            sq = sq - 1
-        end
-    end
-
-    -- Castles
-    for _, element in castles() do
-        if element == "-" then break
-        elseif element[1] == KING then
-            if element[2] == WHITE then
-                self.flag = bor(self.flag, WKINGCASTLE)
-            else
-                self.flag = bor(self.flag, BKINGCASTLE)
-            end
-        else -- QUEEN
-            if element[2] == WHITE then
-                self.flag = bor(self.flag, WQUEENCASTLE)
-            else
-                self.flag = bor(self.flag, BQUEENCASTLE)
-            end
-        end
-    end
-
-    self.side = side
-    if ep == "-" then self.ep = -1
-    else self.ep = squarei(ep) end
-
-    self.rhmc = rhmc
-    self.fmc = fmc
+    local ok, err, pos = self.core:loadfen(fen or
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1")
+    if not ok then error("invalid fen: " .. err .. " at byte " .. pos, 2) end
 end --}}}
 function Board:make_move(move) --{{{
-    local iswhite = self.side == WHITE
-    local xside = switch_side(self.side)
-    local f, t = fromsq(move), tosq(move)
-    local fpiece = self:get_piece(f)
-    local cpiece
-
-    -- Initialize movelist
-    if #self.movelist == 0 then
-        table.insert(self.movelist, {NULLMOVE, self.flag, self.ep, self.rhmc})
-    end
-
-    -- Clear pieces
-    self:clear_piece(f, fpiece, self.side)
-    if tstbit(move, CAPTURE) then
-        cpiece = capture_piece(move)
-        self:clear_piece(t, cpiece, xside)
-    elseif tstbit(move, ENPASSANT) then
-        local epsq = iswhite and t - 8 or t + 8
-        self:clear_piece(epsq, PAWN, xside)
-    end
-
-    -- Set pieces
-    if tstbit(move, PROMOTION) then
-        self:set_piece(t, promote_piece(move), self.side)
-    else
-        self:set_piece(t, fpiece, self.side)
-    end
-
-    -- Castling
-    if tstbit(move, CASTLING) then
-        local rl, rf
-        if t > f then -- Castle kingside
-            rl = iswhite and self.li_rook[1] or self.li_rook[1] + 56
-            rf = iswhite and squarei"f1" or squarei"f8"
-        else -- Castle queenside
-            rl = iswhite and self.li_rook[2] or self.li_rook[2] + 56
-            rf = iswhite and squarei"d1" or squarei"d8"
-        end
-        self:clear_piece(rl, ROOK, self.side)
-        self:set_piece(rf, ROOK, self.side)
-        -- Clear castling rights
-        if iswhite then self.flag = band(self.flag, bnot(WCASTLE))
-        else self.flag = band(self.flag, bnot(BCASTLE)) end
-    elseif fpiece == KING then
-        -- Clear castling rights
-        if iswhite then self.flag = band(self.flag, bnot(WCASTLE))
-        else self.flag = band(self.flag, bnot(BCASTLE)) end
-    end
-
-    -- Clear the appropriate castling flag if a rook has moved.
-    if fpiece == ROOK then
-        if iswhite then
-            if tstbit(self.flag, WKINGCASTLE) and f == self.li_rook[1] then
-                self.flag = band(self.flag, bnot(WKINGCASTLE))
-            elseif tstbit(self.flag, WQUEENCASTLE) and f == self.li_rook[2] then
-                self.flag = band(self.flag, bnot(WQUEENCASTLE))
-            end
-        else
-            if tstbit(self.flag, BKINGCASTLE) and f == self.li_rook[1] + 56 then
-                self.flag = band(self.flag, bnot(BKINGCASTLE))
-            elseif tstbit(self.flag, BQUEENCASTLE) and f == self.li_rook[2] + 56 then
-                self.flag = band(self.flag, bnot(BQUEENCASTLE))
-            end
-        end
-    end
-
-    -- Clear the appropriate castling flag if a rook has been captured.
-    if cpiece == ROOK then
-        if xside == WHITE then -- A white rook has been captured.
-            if tstbit(self.flag, WKINGCASTLE) and t == self.li_rook[1] then
-                self.flag = band(self.flag, bnot(WKINGCASTLE))
-            elseif tstbit(self.flag, WQUEENCASTLE) and t == self.li_rook[2] then
-                self.flag = band(self.flag, bnot(WQUEENCASTLE))
-            end
-        else -- A black rook has been captured
-            if tstbit(self.flag, BKINGCASTLE) and t == self.li_rook[1] + 56 then
-                self.flag = band(self.flag, bnot(BKINGCASTLE))
-            elseif tstbit(self.flag, BQUEENCASTLE) and t == self.li_rook[2] + 56 then
-                self.flag = band(self.flag, bnot(BQUEENCASTLE))
-            end
-        end
-    elseif cpiece == KING then -- only happens in some wild variants.
-        if iswhite then self.flag = band(self.flag, bnot(WCASTLE))
-        else self.flag = band(self.flag, bnot(BCASTLE)) end
-    end
-
-    -- If pawn moved two squares set the enpassant square.
-    if fpiece == PAWN and math.abs(f - t) == 16 then
-        self.ep = (f + t) / 2
-    else
-        self.ep = -1
-    end
-
-    -- Update move counters
-    if fpiece == PAWN or tstbit(move, CAPTURE) then
-        self.rhmc = 0
-    else
-        self.rhmc = self.rhmc + 1
-    end
-    if self.side == BLACK then self.fmc = self.fmc + 1 end
-
-    self.side = xside
-    table.insert(self.movelist, {move, self.flag, self.ep, self.rhmc})
-    return move
+    return self.core:make_move(move)
 end --}}}
 function Board:unmake_move() --{{{
-    -- If side is black, black is about to move, but we will be undoing a move
-    -- by white, not black.
-    local mllen = #self.movelist
-    assert(mllen > 0, "no moves made yet")
-    assert(self.movelist[mllen][1] ~= NULLMOVE, "initial position")
-    local move = table.remove(self.movelist)[1]
-    local lastmove = self.movelist[mllen - 1]
-    local f, t = fromsq(move), tosq(move)
-    local fpiece = self:get_piece(t)
-    local cpiece = capture_piece(move)
-    local side = switch_side(self.side)
-    local xside = self.side
-    local iswhite = side == WHITE
-
-    self:clear_piece(t, fpiece, side)
-    self:set_piece(f, fpiece, side)
-
-    -- If capture, put back the captured piece
-    if tstbit(move, CAPTURE) then
-        self:set_piece(t, cpiece, xside)
-    end
-
-    -- Undo promotion
-    if tstbit(move, PROMOTION) then
-        self:clear_piece(f, fpiece, side)
-        self:set_piece(f, PAWN, side)
-    end
-
-    -- Undo enpassant
-    if tstbit(move, ENPASSANT) then
-        local epsq = iswhite and t - 8 or t + 8
-        self:set_piece(epsq, PAWN, xside)
-    end
-
-    -- If castling, undo rook move
-    if tstbit(move, CASTLING) then
-        if iswhite then
-            if t == squarei"g1" then -- castle kingside
-                self:clear_piece(squarei"f1", ROOK, side)
-                self:set_piece(self.li_rook[1], ROOK, side)
-            else -- castle queenside
-                self:clear_piece(squarei"d1", ROOK, side)
-                self:set_piece(self.li_rook[2], ROOK, side)
-            end
-        else
-            if t == squarei"g8" then -- castle kingside
-                self:clear_piece(squarei"f8", ROOK, side)
-                self:set_piece(self.li_rook[1] + 56, ROOK, side)
-            else -- castle queenside
-                self:clear_piece(squarei"d8", ROOK, side)
-                self:set_piece(self.li_rook[2] + 56, ROOK, side)
-            end
-        end
-    end
-
-    -- Restore castling flags, enpassant square and move counters
-    self.flag = lastmove[2]
-    self.ep = lastmove[3]
-    self.rhmc = lastmove[4]
-    if not iswhite then self.fmc = self.fmc - 1 end
-
-    self.side = side
-    return move
+    return self.core:unmake_move()
 end --}}}
 function Board:move_san(smove) --{{{
     local parsed = move.san_move:match(smove)
@@ -702,15 +455,13 @@ function Board:move_san(smove) --{{{
         if not f then
             local pbb = self.bitboard.pieces[self.side][parsed.piece]
             local attackbb = atak(parsed.piece, t, nil, self.bitboard.occupied[3])
-            for sq=0,63 do
-                if attackbb:tstbit(sq) then
-                    if ((not ffile and not frank) or
-                        (ffile and ffile == filec(sq)) or
-                        (frank and frank == rank(sq))) and
-                        pbb:tstbit(sq) then
-                        f = sq
-                        break
-                    end
+            -- bb - bb is the intersection of the two bitboards.
+            for sq in (attackbb - pbb):squares() do
+                if (not ffile and not frank) or
+                    (ffile and ffile == filec(sq)) or
+                    (frank and frank == rank(sq)) then
+                    f = sq
+                    break
                 end
             end
         end
@@ -739,6 +490,87 @@ function Board:move_san(smove) --{{{
 
     return self:make_move(m)
 end --}}}
+function Board:legal_moves() --{{{
+    return self.core:legal_moves()
+end --}}}
+function Board:pseudo_moves() --{{{
+    return self.core:pseudo_moves()
+end --}}}
+function Board:in_check() --{{{
+    return self.core:in_check()
+end --}}}
+function Board:attackers_to(square, side) --{{{
+    return attackers_to(self.core, square, side)
+end --}}}
+function Board:attacked_by(side) --{{{
+    return attacked_by(self.core, side)
+end --}}}
+function Board:see(move) --{{{
+    return see(self.core, move)
+end --}}}
+function Board:is_in_check(side) --{{{
+    side = side or self.side
+    local king = self.bitboard.pieces[side][KING]:lsb()
+    if not king then return false end
+    return attackers_to(self.core, king, switch_side(side)) ~= NULL
+end --}}}
+function Board:can_castle(kingside) --{{{
+    local iswhite = self.side == WHITE
+    local base = iswhite and 0 or 56
+    local flag
+    if kingside then flag = iswhite and WKINGCASTLE or BKINGCASTLE
+    else flag = iswhite and WQUEENCASTLE or BQUEENCASTLE end
+    if not tstbit(self.flag, flag) then return false end
+
+    local kf = self.li_king + base
+    local rf = (kingside and self.li_rook[1] or self.li_rook[2]) + base
+    local kt = base + (kingside and 6 or 2)
+    local rt = base + (kingside and 5 or 3)
+    if self:get_piece(kf) ~= KING or self:get_piece(rf) ~= ROOK then
+        return false
+    end
+
+    -- Squares the king and the rook pass over must be empty.
+    local occupied = self.bitboard.occupied[3]
+    for sq=math.min(kf, kt, rf, rt),math.max(kf, kt, rf, rt) do
+        if sq ~= kf and sq ~= rf and occupied:tstbit(sq) then return false end
+    end
+
+    -- The king may not castle out of, through or into check. The fischerandom
+    -- case of the castling rook hiding an attack is left to legal_moves().
+    local attacked = attacked_by(self.core, switch_side(self.side))
+    for sq=math.min(kf, kt),math.max(kf, kt) do
+        if attacked:tstbit(sq) then return false end
+    end
+    return true
+end --}}}
+function Board:perft(depth) --{{{
+    depth = assert(tonumber(depth), "depth not a number")
+    if depth < 1 then return 1 end
+    local moves = self:legal_moves()
+    if depth == 1 then return #moves end
+
+    local nodes = 0
+    for _, m in ipairs(moves) do
+        self:make_move(m)
+        nodes = nodes + self:perft(depth - 1)
+        self:unmake_move()
+    end
+    return nodes
+end --}}}
+function Board:divide(depth) --{{{
+    depth = assert(tonumber(depth), "depth not a number")
+    assert(depth > 0, "invalid depth")
+
+    local div, total = {}, 0
+    for _, m in ipairs(self:legal_moves()) do
+        self:make_move(m)
+        div[m] = self:perft(depth - 1)
+        self:unmake_move()
+        total = total + div[m]
+    end
+    return div, total
+end --}}}
 function Board:generate_legal_pawn_moves(square, promoteking) --{{{
     square = assert(tonumber(square), "invalid square")
     assert(square > -1 and square < 64, "invalid square")
@@ -746,141 +578,14 @@ function Board:generate_legal_pawn_moves(square, promoteking) --{{{
     assert(PAWN == self:get_piece(square), "no pawn on the given square")
 
     local lglmoves = {}
-
-    -- One step forward
-    local osf
-    if self.side == WHITE then
-        osf = square + 8
-    else
-        osf = square - 8
-    end
-
-    if square_isvalid(osf) then
-        if not self.bitboard.occupied[3]:tstbit(osf) then
-            -- Pawn can move one step forward legally.
-            local m = MOVE(square, osf)
-            -- Check for promotion
-            if (self.side == WHITE and rank(osf) == 8) or (self.side == BLACK and rank(osf) == 1) then
-                -- Pawn has to promote to a piece.
-                table.insert(lglmoves, bor(m, KNIGHTPRM))
-                table.insert(lglmoves, bor(m, BISHOPPRM))
-                table.insert(lglmoves, bor(m, ROOKPRM))
-                table.insert(lglmoves, bor(m, QUEENPRM))
-                if promoteking then table.insert(lglmoves, bor(m, KINGPRM)) end
-            else
-                table.insert(lglmoves, m)
-            end
-        end
-    end
-
-    -- Two steps forward
-    if (self.side == WHITE and rank(square) == 2) or (self.side == BLACK and rank(square) == 7) then
-        local tsf
-        if self.side == WHITE then
-            tsf = square + 16
-        else
-            tsf = square - 16
-        end
-
-        if square_isvalid(tsf) then
-            if not self.bitboard.occupied[3]:tstbit(osf) and not self.bitboard.occupied[3]:tstbit(tsf) then
-                -- Pawn can move two steps forward legally.
-                -- No need to check for promotion.
-                local m = MOVE(square, tsf)
-                table.insert(lglmoves, m)
-            end
-        end
-    end
-
-    -- Diagonal one step captures
-    if self.side == WHITE then
-        -- First possibility of attack: /
-        local slsq = square + 9
-        if square_isvalid(square) then
-            if self.bitboard.occupied[BLACK]:tstbit(slsq) then
-                -- White pawn can capture the piece on slsq.
-                local m = bor(MOVE(square, slsq), capture_bit(self.cboard[slsq + 1]))
-                -- Check for promotion
-                if rank(slsq) == 8 then
-                    -- Pawn has to promote to a piece.
-                    table.insert(lglmoves, bor(m, KNIGHTPRM))
-                    table.insert(lglmoves, bor(m, BISHOPPRM))
-                    table.insert(lglmoves, bor(m, ROOKPRM))
-                    table.insert(lglmoves, bor(m, QUEENPRM))
-                    if promoteking then table.insert(lglmoves, bor(m, KINGPRM)) end
-                else
-                    table.insert(lglmoves, m)
-                end
-            end
-        end
-
-        -- Second possibility of attack: \
-        local bslsq = square + 7
-        if square_isvalid(square) then
-            if self.bitboard.occupied[BLACK]:tstbit(bslsq) then
-                -- White pawn can capture the piece on bslsq.
-                local m = bor(MOVE(square, slsq), capture_bit(self.cboard[bslsq + 1]))
-                -- Check for promotion
-                if rank(bslsq) == 1 then
-                    -- Pawn has to promote to a piece.
-                    table.insert(lglmoves, bor(m, KNIGHTPRM))
-                    table.insert(lglmoves, bor(m, BISHOPPRM))
-                    table.insert(lglmoves, bor(m, ROOKPRM))
-                    table.insert(lglmoves, bor(m, QUEENPRM))
-                    if promoteking then table.insert(lglmoves, bor(m, KINGPRM)) end
-                else
-                    table.insert(lglmoves, m)
-                end
-            end
-        end
-    else -- if self.side == BLACK
-        -- First possibility of attack: \
-        local slsq = square - 7
-        if square_isvalid(square) then
-            if self.bitboard.occupied[WHITE]:tstbit(slsq) then
-                -- Black pawn can capture the piece on slsq.
-                local m = bor(MOVE(square, slsq), capture_bit(self.cboard[slsq + 1]))
-                -- Check for promotion
-                if rank(slsq) == 1 then
-                    -- Pawn has to promote to a piece.
-                    table.insert(lglmoves, bor(m, KNIGHTPRM))
-                    table.insert(lglmoves, bor(m, BISHOPPRM))
-                    table.insert(lglmoves, bor(m, ROOKPRM))
-                    table.insert(lglmoves, bor(m, QUEENPRM))
-                    if promoteking then table.insert(lglmoves, bor(m, KINGPRM)) end
-                else
-                    table.insert(lglmoves, m)
-                end
-            end
-        end
-
-        -- Second possibility of attack: /
-        local bslsq = square - 9
-        if square_isvalid(square) then
-            if self.bitboard.occupied[WHITE]:tstbit(bslsq) then
-                -- Black pawn can capture the piece on bslsq.
-                local m = bor(MOVE(square, bslsq), capture_bit(self.cboard[bslsq + 1]))
-                -- Check for promotion
-                if rank(bslsq) == 1 then
-                    -- Pawn has to promote to a piece.
-                    table.insert(lglmoves, bor(m, KNIGHTPRM))
-                    table.insert(lglmoves, bor(m, BISHOPPRM))
-                    table.insert(lglmoves, bor(m, ROOKPRM))
-                    table.insert(lglmoves, bor(m, QUEENPRM))
-                    if promoteking then table.insert(lglmoves, bor(m, KINGPRM)) end
-                else
-                    table.insert(lglmoves, m)
-                end
+    for _, m in ipairs(self.core:legal_moves()) do
+        if band(rshift(m, 6), 0x3f) == square then
+            table.insert(lglmoves, m)
+            -- Kings are added after queens for suicide chess.
+            if promoteking and band(m, PROMOTION) == QUEENPRM then
+                table.insert(lglmoves, bor(bxor(m, QUEENPRM), KINGPRM))
             end
         end
     end
-
-    -- Check for en passant
-    if self.ep ~= -1 and
-        ((self.side == WHITE and self.ep == square + 9 or self.ep == square + 7) or
-        (self.side == BLACK and self.ep == square - 9 or self.ep == square - 7)) then
-        table.insert(lglmoves, bor(MOVE(square, self.ep), PAWNCAP))
-    end
-
     return lglmoves
 end --}}}
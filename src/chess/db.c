@@ -0,0 +1,648 @@
+/* Binary game databases for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* File layout, all integers are little endian:
+ *
+ *   header:  "LCHESSDB" version:u32 ngames:u32 index:u64
+ *   games:   tagbytes:u32 nmoves:u32 tags[tagbytes] pad moves:u16[nmoves]
+ *   index:   offset:u64[ngames]
+ *
+ * The tags are nul terminated name and value pairs. A move is stored as the
+ * low 15 bits of MOVE(), that is origin, destination and promotion, and bit
+ * 15 marks castling and en passant. Captures are restored from the board when
+ * the game is replayed, when the moves are checked to be legal. Moves start at
+ * an even offset.
+ */
+
+#include <errno.h>
+#include <stdio.h> /* for FILE */
+#include <stdlib.h> /* for malloc, realloc, free */
+#include <string.h> /* for memcpy, strerror */
+
+#include "lua.h"
+#include "lauxlib.h"
+
+#include "bitboard.h"
+#include "board.h"
+#include "db.h"
+
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* HAVE_MMAP */
+
+/* Prototypes */
+void db_open(lua_State *L);
+
+#define DB_MAGIC "LCHESSDB"
+#define DB_VERSION 1
+#define DB_HEADER_SIZE 24
+#define DB_GAME_SIZE 8
+#define DB_SPECIAL 0x8000
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+struct dbwriter {
+    FILE *fp;
+    U64 offset;
+    unsigned int ngames;
+    unsigned int nalloc;
+    U64 *index;
+    /* Games are replayed to check their moves before they're written. */
+    struct board board;
+};
+
+/* Maps a file read-only, without mmap the file is read into memory. Returns 0
+ * on success, 1 if the file is shorter than minsize and -1 with errno set on
+ * errors.
+ */
+int db_map(const char *filename, size_t minsize, const unsigned char **data,
+        size_t *size, int *mapped) {
+    void *p;
+#ifdef HAVE_MMAP
+    int fd;
+    struct stat st;
+
+    if (-1 == (fd = open(filename, O_RDONLY)))
+        return -1;
+    if (0 != fstat(fd, &st)) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < minsize || 0 == st.st_size) {
+        close(fd);
+        return 1;
+    }
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == p)
+        return -1;
+    *data = p;
+    *size = st.st_size;
+    *mapped = 1;
+#else
+    FILE *fp;
+    long len;
+
+    if (NULL == (fp = fopen(filename, "rb")))
+        return -1;
+    if (0 != fseek(fp, 0, SEEK_END) || (len = ftell(fp)) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    rewind(fp);
+    if ((size_t)len < minsize || 0 == len) {
+        fclose(fp);
+        return 1;
+    }
+    if (NULL == (p = malloc(len)) || (size_t)len != fread(p, 1, len, fp)) {
+        free(p);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    *data = p;
+    *size = len;
+    *mapped = 0;
+#endif /* HAVE_MMAP */
+    return 0;
+}
+
+void db_unmap(const unsigned char *data, size_t size, int mapped) {
+#ifdef HAVE_MMAP
+    if (mapped) {
+        munmap((void *)data, size);
+        return;
+    }
+#endif /* HAVE_MMAP */
+    (void)size;
+    (void)mapped;
+    free((void *)data);
+}
+
+struct db *db_check(lua_State *L, int narg) {
+    struct db *db;
+
+    db = luaL_checkudata(L, narg, DB_T);
+    if (NULL == db->data)
+        luaL_argerror(L, narg, "database is closed");
+    return db;
+}
+
+/* Accepts a board userdata or a chess.Board whose core is one. */
+struct board *db_check_board(lua_State *L, int narg) {
+    struct board *b;
+
+    if (LUA_TTABLE == lua_type(L, narg)) {
+        lua_getfield(L, narg, "core");
+        b = luaL_checkudata(L, -1, BOARD_T);
+        lua_pop(L, 1);
+        return b;
+    }
+    return luaL_checkudata(L, narg, BOARD_T);
+}
+
+/* Finds the i'th game counting from 0, the bounds of every field are checked
+ * against the size of the file. Returns -1 if the game is corrupt.
+ */
+int db_game(const struct db *db, unsigned int i, struct dbgame *g) {
+    U64 offset;
+    size_t left;
+
+    offset = get_u64(db->index + (size_t)i * 8);
+    if (offset > db->size || db->size - offset < DB_GAME_SIZE)
+        return -1;
+    g->tagbytes = get_u32(db->data + offset);
+    g->nmoves = get_u32(db->data + offset + 4);
+    offset += DB_GAME_SIZE;
+    left = db->size - offset;
+    if ((U64)g->tagbytes + (g->tagbytes & 1) + (U64)g->nmoves * 2 > left)
+        return -1;
+    g->tags = db->data + offset;
+    g->moves = g->tags + g->tagbytes + (g->tagbytes & 1);
+    return 0;
+}
+
+/* Checks the game number at narg and finds the game. */
+void db_check_game(lua_State *L, const struct db *db, int narg, struct dbgame *g) {
+    int i;
+
+    i = luaL_checkinteger(L, narg);
+    if (i < 1 || (unsigned int)i > db->ngames)
+        luaL_argerror(L, narg, "game number out of range");
+    if (0 != db_game(db, i - 1, g))
+        luaL_error(L, "game %d is corrupt", i);
+}
+
+/* Returns the value of a tag, NULL if the game doesn't have it. */
+static const char *game_tag(const struct dbgame *g, const char *name) {
+    const char *p = (const char *)g->tags;
+    const char *end = p + g->tagbytes;
+    const char *value;
+
+    while (p < end) {
+        value = memchr(p, '\0', end - p);
+        if (NULL == value || NULL == memchr(value + 1, '\0', end - value - 1))
+            return NULL;
+        value++;
+        if (0 == strcmp(p, name))
+            return value;
+        p = value + strlen(value) + 1;
+    }
+    return NULL;
+}
+
+/* Restores the capture, castling and en passant bits of a stored move. */
+static inline int db_unpack(const struct board *b, unsigned int m) {
+    int move = m & 0x7FFF;
+
+    if (m & DB_SPECIAL)
+        return move | ((PAWN == b->cboard[FROMSQ(move)]) ? ENPASSANT : CASTLING);
+    return move | (b->cboard[TOSQ(move)] << 15);
+}
+
+/* Stores the low bits of a move in the format of MOVE(). */
+static inline unsigned int db_pack(int move) {
+    return (move & 0x7FFF) | ((move & (CASTLING | ENPASSANT)) ? DB_SPECIAL : 0);
+}
+
+/* Plays a stored move if it's legal, returns the move or -1. */
+static int db_play(struct board *b, unsigned int m, const char **errmsg) {
+    int n, move;
+    int legal[MAX_MOVES];
+
+    move = db_unpack(b, m);
+    n = board_generate(b, legal, MAX_MOVES, 1);
+    if (!board_has_move(legal, n, move)) {
+        *errmsg = "illegal move";
+        return -1;
+    }
+    if (0 != board_make_move(b, move)) {
+        *errmsg = "not enough memory";
+        return -1;
+    }
+    return move;
+}
+
+/* Plays the i'th move of the game, returns the move or -1 if it's illegal. */
+int db_step(struct board *b, const struct dbgame *g, unsigned int i,
+        const char **errmsg) {
+    return db_play(b, get_u16(g->moves + 2 * i), errmsg);
+}
+
+/* Sets the board up for the game and plays up to n moves, returns the number
+ * of moves played or -1 if a move is invalid.
+ */
+int db_replay(struct board *b, const struct dbgame *g, unsigned int n,
+        const char **errmsg) {
+    size_t errpos;
+    unsigned int i;
+    const char *fen;
+
+    fen = game_tag(g, "FEN");
+    if (NULL == fen)
+        fen = START_FEN;
+    if (0 != board_loadfen(b, fen, strlen(fen), &errpos, errmsg))
+        return -1;
+
+    if (n > g->nmoves)
+        n = g->nmoves;
+    for (i = 0; i < n; i++) {
+        if (-1 == db_step(b, g, i, errmsg))
+            return -1;
+    }
+    return n;
+}
+
+/* chess.board.opendb(filename) returns the database or nil and an error
+ * message.
+ */
+static int db_new(lua_State *L) {
+    const char *filename;
+    U64 index;
+    struct db *db;
+
+    filename = luaL_checkstring(L, 1);
+    db = (struct db *)lua_newuserdata(L, sizeof(struct db));
+    db->data = NULL;
+    luaL_getmetatable(L, DB_T);
+    lua_setmetatable(L, -2);
+
+    switch (db_map(filename, DB_HEADER_SIZE, &db->data, &db->size, &db->mapped)) {
+        case -1:
+            lua_pushnil(L);
+            lua_pushfstring(L, "%s: %s", filename, strerror(errno));
+            return 2;
+        case 1:
+            lua_pushnil(L);
+            lua_pushfstring(L, "%s: not a game database", filename);
+            return 2;
+    }
+
+    db->ngames = get_u32(db->data + 12);
+    index = get_u64(db->data + 16);
+    if (0 != memcmp(db->data, DB_MAGIC, 8) || DB_VERSION != get_u32(db->data + 8)
+            || index > db->size || (U64)db->ngames * 8 > db->size - index) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "%s: not a game database", filename);
+        return 2;
+    }
+    db->index = db->data + index;
+    return 1;
+}
+
+static int db_close(lua_State *L) {
+    struct db *db;
+
+    db = luaL_checkudata(L, 1, DB_T);
+    if (NULL != db->data) {
+        db_unmap(db->data, db->size, db->mapped);
+        db->data = NULL;
+    }
+    return 0;
+}
+
+static int db_len(lua_State *L) {
+    lua_pushinteger(L, db_check(L, 1)->ngames);
+    return 1;
+}
+
+/* db:tags(i) returns a table of the tags of the i'th game. */
+static int db_tags(lua_State *L) {
+    const char *p, *end, *value;
+    struct db *db;
+    struct dbgame g;
+
+    db = db_check(L, 1);
+    db_check_game(L, db, 2, &g);
+
+    lua_newtable(L);
+    p = (const char *)g.tags;
+    end = p + g.tagbytes;
+    while (p < end) {
+        value = memchr(p, '\0', end - p);
+        if (NULL == value || NULL == memchr(value + 1, '\0', end - value - 1))
+            break;
+        value++;
+        lua_pushstring(L, p);
+        lua_pushstring(L, value);
+        lua_rawset(L, -3);
+        p = value + strlen(value) + 1;
+    }
+    return 1;
+}
+
+/* db:nmoves(i) returns the number of moves of the i'th game. */
+static int db_nmoves(lua_State *L) {
+    struct db *db;
+    struct dbgame g;
+
+    db = db_check(L, 1);
+    db_check_game(L, db, 2, &g);
+    lua_pushinteger(L, g.nmoves);
+    return 1;
+}
+
+/* db:replay(i, board, n) sets board up for the i'th game and plays the first
+ * n moves, all of them if n isn't given. Returns the number of moves played.
+ */
+static int db_replay_lua(lua_State *L) {
+    int n;
+    const char *errmsg;
+    struct db *db;
+    struct dbgame g;
+    struct board *b;
+
+    db = db_check(L, 1);
+    db_check_game(L, db, 2, &g);
+    b = db_check_board(L, 3);
+    n = luaL_optinteger(L, 4, g.nmoves);
+    if (n < 0)
+        return luaL_argerror(L, 4, "negative number of moves");
+
+    if (-1 == (n = db_replay(b, &g, n, &errmsg)))
+        return luaL_error(L, "game %d: %s", (int)lua_tointeger(L, 2), errmsg);
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+/* db:moves(i, board) returns an array of the moves of the i'th game in the
+ * format of chess.MOVE(), the board is left at the end of the game.
+ */
+static int db_moves(lua_State *L) {
+    unsigned int i;
+    int move;
+    const char *errmsg;
+    struct db *db;
+    struct dbgame g;
+    struct board *b;
+
+    db = db_check(L, 1);
+    db_check_game(L, db, 2, &g);
+    b = db_check_board(L, 3);
+
+    if (-1 == db_replay(b, &g, 0, &errmsg))
+        return luaL_error(L, "game %d: %s", (int)lua_tointeger(L, 2), errmsg);
+    lua_createtable(L, g.nmoves, 0);
+    for (i = 0; i < g.nmoves; i++) {
+        if (-1 == (move = db_step(b, &g, i, &errmsg)))
+            return luaL_error(L, "game %d: %s", (int)lua_tointeger(L, 2), errmsg);
+        lua_pushinteger(L, move);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+/* chess.board.newdb(filename) returns a writer or nil and an error message. */
+static int dbwriter_new(lua_State *L) {
+    const char *filename;
+    unsigned char header[DB_HEADER_SIZE];
+    struct dbwriter *w;
+
+    filename = luaL_checkstring(L, 1);
+    w = (struct dbwriter *)lua_newuserdata(L, sizeof(struct dbwriter));
+    w->fp = NULL;
+    w->index = NULL;
+    w->ngames = w->nalloc = 0;
+    w->board.hsize = 0;
+    w->board.history = NULL;
+    w->board.side = WHITE;
+    w->board.li_king = 4; /* e1 */
+    w->board.li_rook[0] = 7; /* h1 */
+    w->board.li_rook[1] = 0; /* a1 */
+    luaL_getmetatable(L, DBWRITER_T);
+    lua_setmetatable(L, -2);
+
+    /* The header is written again when the writer is closed. */
+    memset(header, 0, sizeof(header));
+    if (NULL == (w->fp = fopen(filename, "wb"))
+            || 1 != fwrite(header, sizeof(header), 1, w->fp)) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "%s: %s", filename, strerror(errno));
+        return 2;
+    }
+    w->offset = DB_HEADER_SIZE;
+    return 1;
+}
+
+static inline struct dbwriter *check_writer(lua_State *L, int narg) {
+    struct dbwriter *w;
+
+    w = luaL_checkudata(L, narg, DBWRITER_T);
+    if (NULL == w->fp)
+        luaL_argerror(L, narg, "writer is closed");
+    return w;
+}
+
+/* w:add(tags, moves) appends a game, tags is a table of tag names and values,
+ * moves an array of moves in the format of chess.MOVE(). The arguments are
+ * checked before anything is written, the moves must be legal from the
+ * position of the FEN tag or the initial position, and a failed write is
+ * rewound, so the file never holds part of a game.
+ */
+static int dbwriter_add(lua_State *L) {
+    int i, nmoves, move, saved;
+    size_t tagbytes, len, errpos;
+    const char *s, *fen, *errmsg;
+    unsigned char head[DB_GAME_SIZE];
+    unsigned char buf[2];
+    struct dbwriter *w;
+
+    w = check_writer(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    luaL_checktype(L, 3, LUA_TTABLE);
+    nmoves = lua_objlen(L, 3);
+
+    if (w->ngames == w->nalloc) {
+        unsigned int nalloc = w->nalloc ? 2 * w->nalloc : 256;
+        U64 *index = realloc(w->index, nalloc * sizeof(U64));
+        if (NULL == index)
+            return luaL_error(L, "not enough memory");
+        w->index = index;
+        w->nalloc = nalloc;
+    }
+
+    /* Tags are written in two passes, the first one finds their size. */
+    tagbytes = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 2)) {
+        if (LUA_TSTRING != lua_type(L, -2) || !lua_isstring(L, -1))
+            return luaL_argerror(L, 2, "tags must be strings");
+        tagbytes += lua_objlen(L, -2) + lua_objlen(L, -1) + 2;
+        lua_pop(L, 1);
+    }
+    lua_getfield(L, 2, "FEN");
+    if (lua_isnil(L, -1)) {
+        fen = START_FEN;
+        len = strlen(fen);
+    }
+    else
+        fen = lua_tolstring(L, -1, &len);
+    if (0 != board_loadfen(&w->board, fen, len, &errpos, &errmsg))
+        return luaL_argerror(L, 2, lua_pushfstring(L, "invalid fen: %s at byte %d",
+                    errmsg, (int)errpos + 1));
+    lua_pop(L, 1);
+    for (i = 1; i <= nmoves; i++) {
+        lua_rawgeti(L, 3, i);
+        if (LUA_TNUMBER != lua_type(L, -1)) {
+            lua_pushfstring(L, "move %d is not a number", i);
+            return luaL_argerror(L, 3, lua_tostring(L, -1));
+        }
+        move = lua_tointeger(L, -1);
+        if (-1 == db_play(&w->board, db_pack(move), &errmsg)) {
+            lua_pushfstring(L, "move %d: %s", i, errmsg);
+            return luaL_argerror(L, 3, lua_tostring(L, -1));
+        }
+        lua_pop(L, 1);
+    }
+
+    put_u32(head, tagbytes);
+    put_u32(head + 4, nmoves);
+    if (1 != fwrite(head, sizeof(head), 1, w->fp))
+        goto fail;
+    lua_pushnil(L);
+    while (lua_next(L, 2)) {
+        s = lua_tolstring(L, -2, &len);
+        if (len + 1 != fwrite(s, 1, len + 1, w->fp))
+            goto fail;
+        s = lua_tolstring(L, -1, &len);
+        if (len + 1 != fwrite(s, 1, len + 1, w->fp))
+            goto fail;
+        lua_pop(L, 1);
+    }
+    if ((tagbytes & 1) && EOF == fputc('\0', w->fp))
+        goto fail;
+    for (i = 1; i <= nmoves; i++) {
+        lua_rawgeti(L, 3, i);
+        move = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        put_u16(buf, db_pack(move));
+        if (1 != fwrite(buf, sizeof(buf), 1, w->fp))
+            goto fail;
+    }
+
+    w->index[w->ngames++] = w->offset;
+    w->offset += DB_GAME_SIZE + tagbytes + (tagbytes & 1) + 2 * (U64)nmoves;
+    lua_pushinteger(L, w->ngames);
+    return 1;
+
+fail:
+    /* The next game or the index overwrites what was written. */
+    saved = errno;
+    fseek(w->fp, (long)w->offset, SEEK_SET);
+    return luaL_error(L, "write error: %s", strerror(saved));
+}
+
+/* w:close() writes the index and the header, returns true or nil and an
+ * error message.
+ */
+static int dbwriter_close(lua_State *L) {
+    unsigned int i;
+    int ok;
+    unsigned char buf[DB_HEADER_SIZE];
+    struct dbwriter *w;
+
+    w = check_writer(L, 1);
+
+    ok = 1;
+    for (i = 0; ok && i < w->ngames; i++) {
+        put_u64(buf, w->index[i]);
+        ok = (1 == fwrite(buf, 8, 1, w->fp));
+    }
+    memcpy(buf, DB_MAGIC, 8);
+    put_u32(buf + 8, DB_VERSION);
+    put_u32(buf + 12, w->ngames);
+    put_u64(buf + 16, w->offset);
+    ok = ok && 0 == fseek(w->fp, 0, SEEK_SET) && 1 == fwrite(buf, sizeof(buf), 1, w->fp);
+    ok = (0 == fclose(w->fp)) && ok;
+    w->fp = NULL;
+    free(w->index);
+    w->index = NULL;
+    free(w->board.history);
+    w->board.history = NULL;
+
+    if (!ok) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "write error: %s", strerror(errno));
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int dbwriter_gc(lua_State *L) {
+    struct dbwriter *w;
+
+    w = luaL_checkudata(L, 1, DBWRITER_T);
+    if (NULL != w->fp)
+        fclose(w->fp);
+    w->fp = NULL;
+    free(w->index);
+    w->index = NULL;
+    free(w->board.history);
+    w->board.history = NULL;
+    return 0;
+}
+
+static const struct luaL_reg db_methods[] = {
+    {"__gc", db_close},
+    {"__len", db_len},
+    {"close", db_close},
+    {"count", db_len},
+    {"tags", db_tags},
+    {"nmoves", db_nmoves},
+    {"replay", db_replay_lua},
+    {"moves", db_moves},
+    {NULL, NULL}
+};
+
+static const struct luaL_reg dbwriter_methods[] = {
+    {"__gc", dbwriter_gc},
+    {"add", dbwriter_add},
+    {"close", dbwriter_close},
+    {NULL, NULL}
+};
+
+void db_open(lua_State *L) {
+    /* Register DB_T and DBWRITER_T metatables */
+    luaL_newmetatable(L, DB_T);
+    luaL_register(L, NULL, db_methods);
+    lua_pushliteral(L, "__index");
+    lua_pushvalue(L, -2);
+    lua_settable(L, -3);
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, DBWRITER_T);
+    luaL_register(L, NULL, dbwriter_methods);
+    lua_pushliteral(L, "__index");
+    lua_pushvalue(L, -2);
+    lua_settable(L, -3);
+    lua_pop(L, 1);
+
+    /* Push opendb and newdb to the module table */
+    lua_pushliteral(L, "opendb");
+    lua_pushcfunction(L, db_new);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "newdb");
+    lua_pushcfunction(L, dbwriter_new);
+    lua_settable(L, -3);
+}
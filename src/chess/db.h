@@ -0,0 +1,92 @@
+/* Binary game databases for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LUACHESS_GUARD_DB_H
+#define LUACHESS_GUARD_DB_H 1
+
+#include <stddef.h> /* for size_t */
+
+#include "lua.h"
+
+#include "bitboard.h"
+#include "board.h"
+
+#define DB_T "LuaChess.Database"
+#define DBWRITER_T "LuaChess.DatabaseWriter"
+#define POSINDEX_T "LuaChess.PositionIndex"
+#define BOOK_T "LuaChess.Book"
+
+struct db {
+    const unsigned char *data;
+    size_t size;
+    unsigned int ngames;
+    const unsigned char *index;
+    int mapped;
+};
+
+/* A game of the database, tags and moves point into the mapping. */
+struct dbgame {
+    const unsigned char *tags;
+    unsigned int tagbytes;
+    const unsigned char *moves;
+    unsigned int nmoves;
+};
+
+/* The files are little endian whatever the host is. */
+static inline unsigned int get_u16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline unsigned int get_u32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static inline U64 get_u64(const unsigned char *p) {
+    return get_u32(p) | ((U64)get_u32(p + 4) << 32);
+}
+
+static inline void put_u16(unsigned char *p, unsigned int v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static inline void put_u32(unsigned char *p, unsigned int v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+static inline void put_u64(unsigned char *p, U64 v) {
+    put_u32(p, (unsigned int)(v & 0xFFFFFFFFULL));
+    put_u32(p + 4, (unsigned int)(v >> 32));
+}
+
+/* db.c */
+int db_map(const char *filename, size_t minsize, const unsigned char **data,
+        size_t *size, int *mapped);
+void db_unmap(const unsigned char *data, size_t size, int mapped);
+struct db *db_check(lua_State *L, int narg);
+struct board *db_check_board(lua_State *L, int narg);
+void db_check_game(lua_State *L, const struct db *db, int narg, struct dbgame *g);
+int db_game(const struct db *db, unsigned int i, struct dbgame *g);
+int db_replay(struct board *b, const struct dbgame *g, unsigned int n,
+        const char **errmsg);
+int db_step(struct board *b, const struct dbgame *g, unsigned int i,
+        const char **errmsg);
+
+#endif /* LUACHESS_GUARD_DB_H */
@@ -0,0 +1,250 @@
+/* FEN parsing and serialization for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stddef.h> /* for size_t */
+#include <stdio.h> /* for snprintf */
+
+#include "bitboard.h"
+#include "board.h"
+
+static const char fen_pieces[2][7] = {
+    {0, 'P', 'N', 'B', 'R', 'Q', 'K'},
+    {0, 'p', 'n', 'b', 'r', 'q', 'k'},
+};
+
+/* Returns the piece for a FEN letter and sets its side, 0 if it's not one. */
+static inline int fen_piece(char c, int *side) {
+    int piece;
+
+    for (piece = PAWN; piece <= KING; piece++) {
+        if (c == fen_pieces[0][piece]) {
+            *side = WHITE;
+            return piece;
+        }
+        else if (c == fen_pieces[1][piece]) {
+            *side = BLACK;
+            return piece;
+        }
+    }
+    return 0;
+}
+
+/* Parses a move counter starting at fen[*pos], returns -1 on error. */
+static int fen_counter(const char *fen, size_t len, size_t *pos) {
+    int n = 0;
+    size_t start = *pos;
+
+    while (*pos < len && fen[*pos] >= '0' && fen[*pos] <= '9') {
+        n = n * 10 + (fen[*pos] - '0');
+        if (n > COUNTER_MAX)
+            return -1;
+        ++*pos;
+    }
+    return (*pos == start) ? -1 : n;
+}
+
+#define FEN_ERROR(msg)          \
+    do {                        \
+        *errpos = pos;          \
+        *errmsg = (msg);        \
+        return -1;              \
+    } while (0)
+
+#define FEN_SPACE(msg)                          \
+    do {                                        \
+        if (pos >= len || ' ' != fen[pos])      \
+            FEN_ERROR(msg);                     \
+        pos++;                                  \
+    } while (0)
+
+/* Loads the position described by the first len bytes of fen. Trailing bytes
+ * after the move counters are ignored. Returns 0 on success, on failure -1 is
+ * returned, the board is left untouched and errpos and errmsg are set to the
+ * offset of the offending byte and a description of the error.
+ */
+int board_loadfen(struct board *b, const char *fen, size_t len,
+        size_t *errpos, const char **errmsg) {
+    int r, f, n, sq, piece, side, flag, ep, rhmc, fmc;
+    size_t pos;
+    unsigned char pieces[64];
+    unsigned char sides[64];
+
+    pos = 0;
+
+    /* Piece placement, from the eighth rank down to the first */
+    for (r = 7; r >= 0; r--) {
+        f = 0;
+        while (f < 8) {
+            if (pos >= len)
+                FEN_ERROR("rank too short");
+            if (fen[pos] >= '1' && fen[pos] <= '8') {
+                n = fen[pos] - '0';
+                if (f + n > 8)
+                    FEN_ERROR("rank too long");
+                while (n--)
+                    pieces[r * 8 + f++] = 0;
+            }
+            else if (0 != (piece = fen_piece(fen[pos], &side))) {
+                pieces[r * 8 + f] = piece;
+                sides[r * 8 + f] = side;
+                f++;
+            }
+            else if ('/' == fen[pos] || ' ' == fen[pos])
+                FEN_ERROR("rank too short");
+            else
+                FEN_ERROR("invalid piece");
+            pos++;
+        }
+        if (r > 0) {
+            if (pos >= len || '/' != fen[pos])
+                FEN_ERROR((pos < len && ' ' != fen[pos]) ? "rank too long" : "expected '/'");
+            pos++;
+        }
+    }
+
+    /* Side to move */
+    FEN_SPACE("expected ' ' after piece placement");
+    if (pos < len && 'w' == fen[pos])
+        side = WHITE;
+    else if (pos < len && 'b' == fen[pos])
+        side = BLACK;
+    else
+        FEN_ERROR("invalid side to move");
+    pos++;
+
+    /* Castling rights */
+    FEN_SPACE("expected ' ' after side to move");
+    flag = 0;
+    if (pos < len && '-' == fen[pos])
+        pos++;
+    else {
+        for (n = 0; n < 4 && pos < len && ' ' != fen[pos]; n++, pos++) {
+            switch (fen[pos]) {
+                case 'K':
+                    flag |= WKINGCASTLE;
+                    break;
+                case 'Q':
+                    flag |= WQUEENCASTLE;
+                    break;
+                case 'k':
+                    flag |= BKINGCASTLE;
+                    break;
+                case 'q':
+                    flag |= BQUEENCASTLE;
+                    break;
+                default:
+                    FEN_ERROR("invalid castling rights");
+            }
+        }
+        if (0 == n)
+            FEN_ERROR("invalid castling rights");
+    }
+
+    /* En passant square */
+    FEN_SPACE("expected ' ' after castling rights");
+    if (pos < len && '-' == fen[pos]) {
+        ep = -1;
+        pos++;
+    }
+    else {
+        if (pos >= len || fen[pos] < 'a' || fen[pos] > 'h')
+            FEN_ERROR("invalid en passant square");
+        f = fen[pos++] - 'a';
+        if (pos >= len || ('3' != fen[pos] && '6' != fen[pos]))
+            FEN_ERROR("invalid en passant square");
+        ep = (fen[pos++] - '1') * 8 + f;
+    }
+
+    /* Move counters */
+    FEN_SPACE("expected ' ' after en passant square");
+    if (-1 == (rhmc = fen_counter(fen, len, &pos)))
+        FEN_ERROR("invalid half move counter");
+    FEN_SPACE("expected ' ' after half move counter");
+    if (-1 == (fmc = fen_counter(fen, len, &pos)))
+        FEN_ERROR("invalid full move counter");
+
+    /* Everything is fine, set up the board */
+    board_clear(b);
+    for (sq = 0; sq < 64; sq++) {
+        if (pieces[sq])
+            board_set_piece(b, sq, pieces[sq], sides[sq]);
+    }
+    board_set_flag(b, flag);
+    board_set_side(b, side);
+    board_set_ep(b, ep);
+    b->rhmc = rhmc;
+    b->fmc = fmc;
+    return 0;
+}
+
+/* Writes the FEN of the position to buf which must have room for FEN_MAX
+ * bytes, returns the length of the FEN. The result isn't nul terminated.
+ */
+size_t board_fen(const struct board *b, char *buf) {
+    int r, f, sq, empty;
+    char *p = buf;
+
+    for (r = 7; r >= 0; r--) {
+        empty = 0;
+        for (f = 0; f < 8; f++) {
+            sq = r * 8 + f;
+            if (0 == b->cboard[sq]) {
+                empty++;
+                continue;
+            }
+            if (empty) {
+                *p++ = '0' + empty;
+                empty = 0;
+            }
+            *p++ = fen_pieces[board_side_at(b, sq) - 1][b->cboard[sq]];
+        }
+        if (empty)
+            *p++ = '0' + empty;
+        if (r > 0)
+            *p++ = '/';
+    }
+
+    *p++ = ' ';
+    *p++ = (WHITE == b->side) ? 'w' : 'b';
+
+    *p++ = ' ';
+    if (b->flag & (WCASTLE | BCASTLE)) {
+        if (b->flag & WKINGCASTLE)
+            *p++ = 'K';
+        if (b->flag & WQUEENCASTLE)
+            *p++ = 'Q';
+        if (b->flag & BKINGCASTLE)
+            *p++ = 'k';
+        if (b->flag & BQUEENCASTLE)
+            *p++ = 'q';
+    }
+    else
+        *p++ = '-';
+
+    *p++ = ' ';
+    if (-1 == b->ep)
+        *p++ = '-';
+    else {
+        *p++ = 'a' + FILE(b->ep);
+        *p++ = '1' + RANK(b->ep);
+    }
+
+    p += snprintf(p, FEN_MAX - (p - buf), " %d %d", b->rhmc, b->fmc);
+    return p - buf;
+}
@@ -154,7 +154,11 @@ const U64 magicmoves_b_mask[64]=
 	C64(0x0028440200000000), C64(0x0050080402000000), C64(0x0020100804020000), C64(0x0040201008040200)
 };
 
-#ifdef MINIMIZE_MAGIC
+#if defined(MINIMIZE_MAGIC) && defined(USE_PEXT)
+/* The pext indices are dense so the offsets are computed by initmagicmoves. */
+U64 magicmovesbdb[5248];
+const U64* magicmoves_b_indices[64];
+#elif defined(MINIMIZE_MAGIC)
 U64 magicmovesbdb[5248];
 const U64* magicmoves_b_indices[64]=
 {
@@ -184,7 +188,10 @@ const U64* magicmoves_b_indices[64]=
 	#endif
 #endif
 
-#ifdef MINIMIZE_MAGIC
+#if defined(MINIMIZE_MAGIC) && defined(USE_PEXT)
+U64 magicmovesrdb[102400];
+const U64* magicmoves_r_indices[64];
+#elif defined(MINIMIZE_MAGIC)
 U64 magicmovesrdb[102400];
 const U64* magicmoves_r_indices[64]=
 {
@@ -307,7 +314,10 @@ static U64 initmagicmoves_Bmoves(const int square, const U64 occ)
 //used so that the original indices can be left as const so that the compiler can optimize better
 
 #ifndef PERFECT_MAGIC_HASH
-	#ifdef MINIMIZE_MAGIC
+	#ifdef USE_PEXT
+		#define BmagicNOMASK2(square, occupancy) *(magicmoves_b_indices2[square]+_pext_u64(occupancy,magicmoves_b_mask[square]))
+		#define RmagicNOMASK2(square, occupancy) *(magicmoves_r_indices2[square]+_pext_u64(occupancy,magicmoves_r_mask[square]))
+	#elif defined(MINIMIZE_MAGIC)
 		#define BmagicNOMASK2(square, occupancy) *(magicmoves_b_indices2[square]+(((occupancy)*magicmoves_b_magics[square])>>magicmoves_b_shift[square]))
 		#define RmagicNOMASK2(square, occupancy) *(magicmoves_r_indices2[square]+(((occupancy)*magicmoves_r_magics[square])>>magicmoves_r_shift[square]))
 	#else
@@ -336,7 +346,20 @@ void initmagicmoves(void)
 	56, 45, 25, 31, 35, 16,  9, 12,
 	44, 24, 15,  8, 23,  7,  6,  5};
 
-#ifdef MINIMIZE_MAGIC
+#if defined(MINIMIZE_MAGIC) && defined(USE_PEXT)
+	//every square gets a slice of 2^(bits in mask) entries
+	U64* magicmoves_b_indices2[64];
+	U64* magicmoves_r_indices2[64];
+	U64* bnext=magicmovesbdb;
+	U64* rnext=magicmovesrdb;
+	for(i=0;i<64;i++)
+	{
+		magicmoves_b_indices[i]=magicmoves_b_indices2[i]=bnext;
+		bnext+=C64(1)<<__builtin_popcountll(magicmoves_b_mask[i]);
+		magicmoves_r_indices[i]=magicmoves_r_indices2[i]=rnext;
+		rnext+=C64(1)<<__builtin_popcountll(magicmoves_r_mask[i]);
+	}
+#elif defined(MINIMIZE_MAGIC)
 	//identical to magicmove_x_indices except without the const modifer
 	U64* magicmoves_b_indices2[64]=
 	{
@@ -391,6 +414,11 @@ void initmagicmoves(void)
 		int squares[64];
 		int numsquares=0;
 		U64 temp=magicmoves_b_mask[i];
+		#ifdef PERFECT_MAGIC_HASH
+		int first=0;
+		while(first<1428 && magicmovesbdb[first])
+			first++;
+		#endif
 		while(temp)
 		{
 			U64 bit=temp&-temp;
@@ -404,9 +432,11 @@ void initmagicmoves(void)
 				BmagicNOMASK2(i,tempocc)=initmagicmoves_Bmoves(i,tempocc);
 			#else
 				U64 moves=initmagicmoves_Bmoves(i,tempocc);
-				U64 index=(((tempocc)*magicmoves_b_magics[i])>>MINIMAL_B_BITS_SHIFT);
+				U64 index=(((tempocc)*magicmoves_b_magics[i])>>MINIMAL_B_BITS_SHIFT(i));
 				int j;
-				for(j=0;j<1428;j++)
+				//attack sets of different squares never match, so only
+				//the ones of this square are searched
+				for(j=first;j<1428;j++)
 				{
 					if(!magicmovesbdb[j])
 					{
@@ -428,6 +458,11 @@ void initmagicmoves(void)
 		int squares[64];
 		int numsquares=0;
 		U64 temp=magicmoves_r_mask[i];
+		#ifdef PERFECT_MAGIC_HASH
+		int first=0;
+		while(first<4900 && magicmovesrdb[first])
+			first++;
+		#endif
 		while(temp)
 		{
 			U64 bit=temp&-temp;
@@ -441,9 +476,11 @@ void initmagicmoves(void)
 				RmagicNOMASK2(i,tempocc)=initmagicmoves_Rmoves(i,tempocc);
 			#else
 				U64 moves=initmagicmoves_Rmoves(i,tempocc);
-				U64 index=(((tempocc)*magicmoves_r_magics[i])>>MINIMAL_R_BITS_SHIFT);
+				U64 index=(((tempocc)*magicmoves_r_magics[i])>>MINIMAL_R_BITS_SHIFT(i));
 				int j;
-				for(j=0;j<4900;j++)
+				//attack sets of different squares never match, so only
+				//the ones of this square are searched
+				for(j=first;j<4900;j++)
 				{
 					if(!magicmovesrdb[j])
 					{
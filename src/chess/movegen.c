@@ -0,0 +1,292 @@
+/* Move generation for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "bitboard.h"
+#include "board.h"
+#include "attack.h"
+
+int board_in_check(const struct board *b) {
+    U64 kings = b->pieces[b->side - 1][KING - 1];
+
+    if (!kings)
+        return 0;
+    return 0 != board_attackers(b, bitscan(kings), XSIDE(b->side),
+            b->occupied[OCC_ALL]);
+}
+
+/* Appends move to moves unless it's full. */
+static inline int add_move(int *moves, int n, int size, int move) {
+    if (n < size)
+        moves[n++] = move;
+    return n;
+}
+
+/* Adds the moves from square f to every square in targets. */
+static inline int add_moves(const struct board *b, int *moves, int n, int size,
+        int f, U64 targets) {
+    int t;
+
+    while (targets) {
+        t = bitscan(targets);
+        targets &= targets - 1;
+        n = add_move(moves, n, size, MOVE(f, t) | (b->cboard[t] << 15));
+    }
+    return n;
+}
+
+/* Adds the pawn moves from square f to every square in targets, expanding
+ * promotions.
+ */
+static inline int add_pawn_moves(const struct board *b, int *moves, int n, int size,
+        int f, U64 targets) {
+    int t, m;
+
+    while (targets) {
+        t = bitscan(targets);
+        targets &= targets - 1;
+        m = MOVE(f, t) | (b->cboard[t] << 15);
+        if ((1ULL << t) & (RANK_1 | RANK_8)) {
+            n = add_move(moves, n, size, m | KNIGHTPRM);
+            n = add_move(moves, n, size, m | BISHOPPRM);
+            n = add_move(moves, n, size, m | ROOKPRM);
+            n = add_move(moves, n, size, m | QUEENPRM);
+        }
+        else
+            n = add_move(moves, n, size, m);
+    }
+    return n;
+}
+
+/* Adds the castling move described by the king's and rook's initial squares
+ * if it's possible. The king always lands on the g or c file and the rook
+ * on the f or d file so that fischerandom castling works as well.
+ */
+static inline int add_castle(const struct board *b, int *moves, int n, int size,
+        int legal, int kf, int rf, int kingside) {
+    int side = b->side;
+    int xside = XSIDE(side);
+    int base = (WHITE == side) ? 0 : 56;
+    int kt = base + (kingside ? 6 : 2);
+    int rt = base + (kingside ? 5 : 3);
+    int lo, hi, sq;
+    U64 occ, path;
+
+    if (ROOK != b->cboard[rf] || !(b->pieces[side - 1][ROOK - 1] & (1ULL << rf)))
+        return n;
+
+    /* Every square the king and the rook pass over must be empty. */
+    lo = kf < rf ? kf : rf;
+    lo = lo < kt ? lo : kt;
+    lo = lo < rt ? lo : rt;
+    hi = kf > rf ? kf : rf;
+    hi = hi > kt ? hi : kt;
+    hi = hi > rt ? hi : rt;
+    occ = b->occupied[OCC_ALL] & ~((1ULL << kf) | (1ULL << rf));
+    path = ((~0ULL) >> (63 - hi)) & ((~0ULL) << lo);
+    if (occ & path)
+        return n;
+
+    if (legal) {
+        /* The king may not castle out of, through or into check. */
+        lo = kf < kt ? kf : kt;
+        hi = kf > kt ? kf : kt;
+        for (sq = lo; sq <= hi; sq++) {
+            if (board_attackers(b, sq, xside, b->occupied[OCC_ALL]))
+                return n;
+        }
+        /* The castling rook may have been hiding an attack on the king's
+         * destination square.
+         */
+        occ |= (1ULL << kt) | (1ULL << rt);
+        if (board_attackers(b, kt, xside, occ))
+            return n;
+    }
+
+    return add_move(moves, n, size, MOVE(kf, kt) | CASTLING);
+}
+
+/* Generates the moves for the side to move, returns the number of moves
+ * written to moves which has room for size moves. Generation stops when moves
+ * is full, which never happens if size is at least MAX_MOVES. If legal is
+ * non-zero moves leaving the king in check are filtered out.
+ */
+int board_generate(const struct board *b, int *moves, int size, int legal) {
+    int side, xside, ksq, f, t, n, piece, epcap;
+    const U64 *own;
+    const U64 *their;
+    U64 us, them, occ, kings, checkers, checkmask, pinned;
+    U64 bb, targets, snipers, blockers, bit, push;
+
+    side = b->side;
+    xside = XSIDE(side);
+    own = b->pieces[side - 1];
+    their = b->pieces[xside - 1];
+    us = b->occupied[side - 1];
+    them = b->occupied[xside - 1];
+    occ = us | them;
+    kings = own[KING - 1];
+    n = 0;
+
+    ksq = -1;
+    checkers = 0;
+    checkmask = ~0ULL;
+    pinned = 0;
+    if (legal && kings) {
+        ksq = bitscan(kings);
+        checkers = board_attackers(b, ksq, xside, occ);
+        if (checkers) {
+            /* Only king moves may answer a double check. */
+            if (checkers & (checkers - 1))
+                checkmask = 0;
+            else
+                checkmask = BETWEEN[ksq][bitscan(checkers)] | checkers;
+        }
+
+        /* Find pinned pieces */
+        snipers = (Rmagic(ksq, 0) & (their[ROOK - 1] | their[QUEEN - 1]))
+            | (Bmagic(ksq, 0) & (their[BISHOP - 1] | their[QUEEN - 1]));
+        while (snipers) {
+            f = bitscan(snipers);
+            snipers &= snipers - 1;
+            blockers = BETWEEN[ksq][f] & occ;
+            if (blockers && !(blockers & (blockers - 1)))
+                pinned |= blockers & us;
+        }
+    }
+
+    /* Pawns */
+    bb = own[PAWN - 1];
+    while (bb) {
+        f = bitscan(bb);
+        bb &= bb - 1;
+        bit = 1ULL << f;
+
+        targets = pawn_attacks(bit, side) & them;
+        if (WHITE == side) {
+            push = (bit << 8) & ~occ;
+            if (push & RANK_3)
+                push |= (push << 8) & ~occ;
+        }
+        else {
+            push = (bit >> 8) & ~occ;
+            if (push & RANK_6)
+                push |= (push >> 8) & ~occ;
+        }
+        targets |= push;
+        targets &= checkmask;
+        if (pinned & bit)
+            targets &= LINE[ksq][f];
+        n = add_pawn_moves(b, moves, n, size, f, targets);
+
+        /* En passant is checked by playing it out on the occupancy. */
+        if (b->ep >= 0 && (pawn_attacks(bit, side) & (1ULL << b->ep))) {
+            epcap = (WHITE == side) ? b->ep - 8 : b->ep + 8;
+            if (ksq >= 0) {
+                U64 epocc = (occ & ~bit & ~(1ULL << epcap)) | (1ULL << b->ep);
+                if (board_attackers(b, ksq, xside, epocc) & ~(1ULL << epcap))
+                    continue;
+            }
+            n = add_move(moves, n, size, MOVE(f, b->ep) | ENPASSANT);
+        }
+    }
+
+    /* Knights, bishops, rooks and queens */
+    for (piece = KNIGHT; piece <= QUEEN; piece++) {
+        bb = own[piece - 1];
+        while (bb) {
+            f = bitscan(bb);
+            bb &= bb - 1;
+            switch (piece) {
+                case KNIGHT:
+                    targets = KNIGHT_ATTACKS[f];
+                    break;
+                case BISHOP:
+                    targets = Bmagic(f, occ);
+                    break;
+                case ROOK:
+                    targets = Rmagic(f, occ);
+                    break;
+                default:
+                    targets = Qmagic(f, occ);
+                    break;
+            }
+            targets &= ~us & checkmask;
+            if (pinned & (1ULL << f))
+                targets &= LINE[ksq][f];
+            n = add_moves(b, moves, n, size, f, targets);
+        }
+    }
+
+    /* Kings */
+    bb = kings;
+    while (bb) {
+        f = bitscan(bb);
+        bb &= bb - 1;
+        targets = KING_ATTACKS[f] & ~us;
+        if (f == ksq) {
+            /* The king mustn't shadow the attacks of sliders behind it. */
+            U64 kocc = occ & ~(1ULL << f);
+            U64 safe = 0;
+            while (targets) {
+                t = bitscan(targets);
+                targets &= targets - 1;
+                if (!board_attackers(b, t, xside, kocc))
+                    safe |= 1ULL << t;
+            }
+            targets = safe;
+        }
+        n = add_moves(b, moves, n, size, f, targets);
+    }
+
+    /* Castling */
+    if (!checkers) {
+        int base = (WHITE == side) ? 0 : 56;
+        int kf = b->li_king + base;
+
+        if ((kings & (1ULL << kf)) && KING == b->cboard[kf]) {
+            if (b->flag & ((WHITE == side) ? WKINGCASTLE : BKINGCASTLE))
+                n = add_castle(b, moves, n, size, legal, kf, b->li_rook[0] + base, 1);
+            if (b->flag & ((WHITE == side) ? WQUEENCASTLE : BQUEENCASTLE))
+                n = add_castle(b, moves, n, size, legal, kf, b->li_rook[1] + base, 0);
+        }
+    }
+
+    return n;
+}
+
+/* Counts the leaf nodes of the legal move tree of the given depth. */
+U64 board_perft(struct board *b, int depth) {
+    int i, n;
+    int moves[MAX_MOVES];
+    U64 nodes;
+
+    if (depth < 1)
+        return 1;
+    n = board_generate(b, moves, MAX_MOVES, 1);
+    if (1 == depth)
+        return n;
+
+    nodes = 0;
+    for (i = 0; i < n; i++) {
+        board_make_move(b, moves[i]);
+        nodes += board_perft(b, depth - 1);
+        board_unmake_move(b);
+    }
+    return nodes;
+}
@@ -0,0 +1,57 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LUACHESS_GUARD_ONCE_H
+#define LUACHESS_GUARD_ONCE_H 1
+
+#include "config.h"
+
+/* Tables shared by every Lua state of the process are built once, by the
+ * first luaopen_* call that needs them.
+ */
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+
+#define ONCE_T pthread_once_t
+#define ONCE_INIT PTHREAD_ONCE_INIT
+#define run_once(once, init) pthread_once((once), (init))
+#else
+/* Without threads a plain flag does. */
+#define ONCE_T int
+#define ONCE_INIT 0
+
+static inline void run_once(int *once, void (*init)(void)) {
+    if (!*once) {
+        init();
+        *once = 1;
+    }
+}
+#endif /* HAVE_PTHREAD */
+
+/* The tables live in one shared library linked by every module using them, so
+ * there's one copy of them per process. The library is compiled with hidden
+ * visibility, only the declarations marked with TABLES_API are exported.
+ */
+#if defined(__GNUC__) && __GNUC__ >= 4
+#define TABLES_API __attribute__((visibility("default")))
+#else
+#define TABLES_API
+#endif
+
+#endif /* LUACHESS_GUARD_ONCE_H */
@@ -0,0 +1,109 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Perft module for LuaChess
+-- Counts the leaf nodes of the legal move tree of reference positions to check
+-- move generation and make/unmake, and measures their speed.
+
+--{{{Grab environment
+local ipairs = ipairs
+local tostring = tostring
+
+local os = os
+local string = string
+
+local print = print
+
+local chess = require "chess"
+local Board = chess.Board
+local chessboard = require "chess.board"
+--}}}
+
+module "chess.perft"
+
+--{{{Reference positions
+-- Node counts for depths 1, 2, ... from the chessprogramming wiki.
+positions = {
+    {name = "initial",
+    fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    nodes = {20, 400, 8902, 197281, 4865609}},
+    {name = "kiwipete",
+    fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    nodes = {48, 2039, 97862, 4085603}},
+    {name = "position 3",
+    fen = "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    nodes = {14, 191, 2812, 43238, 674624}},
+    {name = "position 4",
+    fen = "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    nodes = {6, 264, 9467, 422333}},
+    {name = "position 5",
+    fen = "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    nodes = {44, 1486, 62379, 2103487}},
+    {name = "position 6",
+    fen = "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    nodes = {46, 2079, 89890, 3894594}},
+}
+--}}}
+--{{{Drivers
+-- Each driver counts the nodes of board at the given depth.
+drivers = {
+    c = function (board, depth) return board.core:perft(depth) end,
+    lua = function (board, depth) return board:perft(depth) end,
+}
+-- Layout of the slider lookup tables the modules were built with, runs of
+-- builds configured with different MAGIC_LAYOUT values can be compared.
+layout = chessboard._MAGIC
+--}}}
+--{{{Functions
+--- Runs perft on every reference position at every depth whose expected node
+-- count doesn't exceed maxnodes.
+-- driver is a key of drivers or a function, defaults to "c".
+-- If verbose is true a line is printed for every position and depth.
+-- Returns true if all counts matched, the total number of nodes and nodes per
+-- second.
+function run(driver, maxnodes, verbose)
+    driver = driver or "c"
+    local count = drivers[driver] or driver
+    local ok, total, elapsed = true, 0, 0
+
+    for _, pos in ipairs(positions) do
+        local board = Board{}
+        board:loadfen(pos.fen)
+        for depth, expected in ipairs(pos.nodes) do
+            if maxnodes and expected > maxnodes then break end
+            local start = os.clock()
+            local nodes = count(board, depth)
+            local spent = os.clock() - start
+            total = total + nodes
+            elapsed = elapsed + spent
+            if nodes ~= expected then ok = false end
+            if verbose then
+                print(string.format("%-12s %d %10d %10d %s", pos.name, depth,
+                    nodes, expected, nodes == expected and "ok" or "FAIL"))
+            end
+        end
+    end
+
+    local nps = elapsed > 0 and total / elapsed or 0
+    if verbose then
+        print(string.format("%s (%s): %d nodes in %.3f seconds, %.0f nodes per second",
+            tostring(driver), layout, total, elapsed, nps))
+    end
+    return ok, total, nps
+end
+--}}}
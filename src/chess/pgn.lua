@@ -0,0 +1,311 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- PGN module for LuaChess
+-- Reads Portable Game Notation in fixed size chunks so that archives of any
+-- size are processed in constant memory, and replays the mainline of the games
+-- on a board.
+
+--{{{Grab environment
+local assert = assert
+local error = error
+local tonumber = tonumber
+local type = type
+
+local string = string
+
+local chess = require "chess"
+local Board = chess.Board
+local chessboard = require "chess.board"
+--}}}
+--{{{Shortcuts to module functions
+local byte, find, gsub, sub = string.byte, string.find, string.gsub, string.sub
+--}}}
+
+module "chess.pgn"
+
+--- Number of bytes read from the source at a time.
+CHUNK_SIZE = 65536
+
+--{{{Tokenizer
+-- Annotation suffixes and their numeric annotation glyphs.
+local suffix_nags = {["!"] = 1, ["?"] = 2, ["!!"] = 3, ["??"] = 4, ["!?"] = 5,
+    ["?!"] = 6}
+
+-- Returns a function reading up to n bytes from source.
+local function reader(source)
+    if type(source) == "function" then return source end
+    return function (n) return source:read(n) end
+end
+
+--- Returns an iterator over the tokens of the PGN read from source.<br />
+-- source is a file handle or a function which is called with the chunk size
+-- and returns the next chunk or nil at the end.<br />
+-- The iterator returns the type of the token and its value:
+-- <ul>
+-- <li>"tag", name, value</li>
+-- <li>"san", move as written without annotation suffixes</li>
+-- <li>"nag", numeric annotation glyph, suffixes like !? are converted</li>
+-- <li>"comment", text of a brace or rest of line comment</li>
+-- <li>"(" and ")", start and end of a variation</li>
+-- <li>"result", one of 1-0, 0-1, 1/2-1/2 and *</li>
+-- </ul>
+-- Move numbers and escaped lines are skipped.
+function tokens(source, chunksize)
+    local read = reader(source)
+    chunksize = chunksize or CHUNK_SIZE
+    -- Only complete lines are kept in buf so that no token but a brace comment
+    -- is ever cut, the partial last line of the chunk waits in rest.
+    local buf, pos, rest, eof = "", 1, "", false
+    local pending
+
+    -- Appends the next complete lines to the unconsumed part of buf, returns
+    -- false if there's nothing left.
+    local function fill()
+        while not eof do
+            local chunk = read(chunksize)
+            if not chunk then
+                eof = true
+                if rest == "" then return false end
+                buf, pos, rest = sub(buf, pos) .. rest, 1, ""
+                return true
+            end
+            local nl = find(chunk, "\n[^\n]*$")
+            if nl then
+                buf, pos = sub(buf, pos) .. rest .. sub(chunk, 1, nl), 1
+                rest = sub(chunk, nl + 1)
+                return true
+            end
+            rest = rest .. chunk
+        end
+        return false
+    end
+
+    return function ()
+        if pending then
+            local nag = pending
+            pending = nil
+            return "nag", nag
+        end
+        while true do
+            local c = byte(buf, pos)
+            if c == 32 or c == 10 or c == 13 or c == 9 then
+                local _, e = find(buf, "^%s*", pos)
+                pos = e + 1
+                c = byte(buf, pos)
+            end
+            if not c then
+                if not fill() then return nil end
+            elseif (c >= 97 and c <= 104) or c == 78 or c == 66 or c == 82
+                    or c == 81 or c == 75 or c == 79 then -- a-h, NBRQKO
+                local _, e, san, suffix = find(buf, "^([^%s%(%){};%[%]$!%?]*)([!%?]*)", pos)
+                pos = e + 1
+                if suffix ~= "" then pending = suffix_nags[suffix] or 0 end
+                return "san", san
+            elseif c == 91 then -- [
+                local _, e, name, value = find(buf, '^%[%s*([%w_]+)%s*"(.-)"%s*%]', pos)
+                if not e then
+                    error("invalid tag '" .. (buf:match("^[^\n]*", pos)) .. "'")
+                end
+                pos = e + 1
+                if find(value, "\\", 1, true) then value = gsub(value, '\\(["\\])', "%1") end
+                return "tag", name, value
+            elseif c == 123 then -- {
+                local e = find(buf, "}", pos, true)
+                if e then
+                    local text = sub(buf, pos + 1, e - 1)
+                    pos = e + 1
+                    return "comment", text
+                elseif not fill() then
+                    error("unterminated comment")
+                end
+            elseif c == 59 or c == 37 then -- ; and %
+                local e = find(buf, "\n", pos, true) or #buf + 1
+                local text = sub(buf, pos + 1, e - 1)
+                pos = e + 1
+                if c == 59 then return "comment", text end
+            elseif c == 40 or c == 41 then -- ( and )
+                pos = pos + 1
+                return c == 40 and "(" or ")"
+            elseif c == 36 then -- $
+                local _, e, nag = find(buf, "^%$(%d+)", pos)
+                if not e then error("invalid numeric annotation glyph") end
+                pos = e + 1
+                return "nag", tonumber(nag)
+            elseif c == 42 then -- *
+                pos = pos + 1
+                return "result", "*"
+            else
+                -- Move numbers come first, they're the most common.
+                local _, e = find(buf, "^%d*%.+", pos)
+                local result
+                if not e then
+                    _, e, result = find(buf, "^([012][/%-][012/%-]*)", pos)
+                end
+                if result == "1-0" or result == "0-1" or result == "1/2-1/2" then
+                    pos = e + 1
+                    return "result", result
+                elseif e and not result then
+                    pos = e + 1
+                else
+                    local _, e, san, suffix = find(buf, "^([^%s%(%){};%[%]$!%?]*)([!%?]*)", pos)
+                    if e < pos then
+                        error("unexpected character '" .. sub(buf, pos, pos) .. "'")
+                    end
+                    pos = e + 1
+                    if san == "" then
+                        return "nag", suffix_nags[suffix] or 0
+                    end
+                    if suffix ~= "" then pending = suffix_nags[suffix] or 0 end
+                    return "san", san
+                end
+            end
+        end
+    end
+end
+--}}}
+--{{{Games
+--- Returns an iterator over the games of the PGN read from source.<br />
+-- See tokens() for source and chunksize. Each game is a table with the fields:
+-- <ul>
+-- <li>tags, table mapping tag names to their values</li>
+-- <li>moves, array of the mainline moves in SAN</li>
+-- <li>result, game termination marker, nil if it's missing</li>
+-- <li>nags, table mapping ply numbers to arrays of glyphs</li>
+-- <li>comments, table mapping ply numbers to comments</li>
+-- </ul>
+-- Comments and glyphs before the first move have the ply number 0. Variations
+-- are skipped.
+function games(source, chunksize)
+    local next_token = tokens(source, chunksize)
+    local held
+
+    return function ()
+        local tags, moves, nags, comments = {}, {}, {}, {}
+        local game = {tags = tags, moves = moves, nags = nags, comments = comments}
+        local started, depth, nmoves = false, 0, 0
+        while true do
+            local t, v, w
+            if held then
+                t, v, w = held[1], held[2], held[3]
+                held = nil
+            else
+                t, v, w = next_token()
+            end
+            if not t then
+                if started then return game end
+                return nil
+            end
+            if t == "tag" and (nmoves > 0 or depth > 0) then
+                -- The previous game has no termination marker.
+                held = {t, v, w}
+                return game
+            end
+            started = true
+            if depth > 0 then
+                if t == "(" then depth = depth + 1
+                elseif t == ")" then depth = depth - 1 end
+            elseif t == "san" then
+                nmoves = nmoves + 1
+                moves[nmoves] = v
+            elseif t == "tag" then
+                tags[v] = w
+            elseif t == "nag" then
+                local list = nags[nmoves]
+                if not list then
+                    list = {}
+                    nags[nmoves] = list
+                end
+                list[#list + 1] = v
+            elseif t == "comment" then
+                local text = comments[nmoves]
+                comments[nmoves] = text and text .. " " .. v or v
+            elseif t == "(" then
+                depth = 1
+            elseif t == "result" then
+                game.result = v
+                return game
+            end
+        end
+    end
+end
+
+--- Returns an iterator replaying the mainline of game on board.<br />
+-- The board is set up from the FEN tag or the initial position and a new
+-- board is created if none is given. Each step makes a move and returns the
+-- ply number, the move in the format of chess.MOVE() and the board. An error
+-- is raised if a move is invalid, illegal or ambiguous.
+function replay(game, board)
+    board = board or Board{}
+    board:loadfen(game.tags.FEN)
+    local core = board.core
+    local parse_san, make_move = core.parse_san, core.make_move
+    local moves, ply = game.moves, 0
+
+    return function ()
+        ply = ply + 1
+        local san = moves[ply]
+        if not san then return nil end
+        local m, err = parse_san(core, san)
+        if not m then
+            error(err .. " '" .. san .. "' at ply " .. ply, 2)
+        end
+        make_move(core, m)
+        return ply, m, board
+    end
+end
+
+--- Returns an iterator replaying the mainline of every game of the PGN read
+-- from source on board.<br />
+-- See tokens() for source and chunksize and replay() for board. Each step
+-- returns the game, the ply number, the move and the board.
+function positions(source, board, chunksize)
+    board = board or Board{}
+    local next_game = games(source, chunksize)
+    local game, next_move
+
+    return function ()
+        while true do
+            if next_move then
+                local ply, m = next_move()
+                if ply then return game, ply, m, board end
+            end
+            game = next_game()
+            if not game then return nil end
+            next_move = replay(game, board)
+        end
+    end
+end
+
+--- Converts the PGN read from source into a binary game database.<br />
+-- See tokens() for source and chunksize and chess.board.newdb() for the
+-- format. An error is raised if a game can't be replayed.
+-- @return the number of games written
+function write_db(source, filename, chunksize)
+    local writer = assert(chessboard.newdb(filename))
+    local board = Board{}
+    local n = 0
+    for game in games(source, chunksize) do
+        local moves = {}
+        for ply, m in replay(game, board) do moves[ply] = m end
+        n = writer:add(game.tags, moves)
+    end
+    assert(writer:close())
+    return n
+end
+--}}}
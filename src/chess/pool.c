@@ -0,0 +1,368 @@
+/* Worker pool for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h> /* for calloc, free */
+#include <unistd.h> /* for sysconf */
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#include "config.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+
+/* Prototypes */
+LUALIB_API int luaopen_chess_pool(lua_State *L);
+
+/* Largest number of workers. */
+#define POOL_MAX 256
+
+/* Deepest table nesting copied between states. */
+#define COPY_DEPTH 32
+
+/* Stack indexes in the state of a worker. */
+#define W_FUNCTION 1
+#define W_RESULTS 2
+#define W_INDICES 3
+
+/* The tasks are handed out by a shared counter, each worker runs in its own
+ * Lua state so the only shared data are this structure and the read-only
+ * tables of the chess modules. A worker copies the task it takes from the
+ * state of the caller, which waits for the workers, while it holds the lock.
+ */
+struct pool {
+    lua_State *L;
+    int tasks;
+    int ntasks;
+    int next;
+    int failed;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;
+#endif /* HAVE_PTHREAD */
+};
+
+/* The results of a worker are kept in the order it ran its tasks, with the
+ * indexes of the tasks beside them.
+ */
+struct worker {
+    lua_State *L;
+    struct pool *pool;
+    int failed;
+    int ndone;
+#ifdef HAVE_PTHREAD
+    pthread_t thread;
+    int started;
+#endif /* HAVE_PTHREAD */
+};
+
+/* Copies the value at index idx of from to the top of to. Only nil, booleans,
+ * numbers, strings and tables of these can be copied, returns -1 for anything
+ * else, for too deeply nested tables and when either stack can't grow.
+ */
+static int copy_value(lua_State *from, int idx, lua_State *to, int depth) {
+    size_t len;
+    const char *s;
+
+    if (idx < 0)
+        idx = lua_gettop(from) + idx + 1;
+    switch (lua_type(from, idx)) {
+        case LUA_TNIL:
+            lua_pushnil(to);
+            return 0;
+        case LUA_TBOOLEAN:
+            lua_pushboolean(to, lua_toboolean(from, idx));
+            return 0;
+        case LUA_TNUMBER:
+            lua_pushnumber(to, lua_tonumber(from, idx));
+            return 0;
+        case LUA_TSTRING:
+            s = lua_tolstring(from, idx, &len);
+            lua_pushlstring(to, s, len);
+            return 0;
+        case LUA_TTABLE:
+            if (depth >= COPY_DEPTH)
+                return -1;
+            /* The table, a key and a value on to, a key and a value on from */
+            if (!lua_checkstack(to, 3) || !lua_checkstack(from, 2))
+                return -1;
+            lua_newtable(to);
+            lua_pushnil(from);
+            while (lua_next(from, idx)) {
+                if (0 != copy_value(from, -2, to, depth + 1)
+                        || 0 != copy_value(from, -1, to, depth + 1)) {
+                    lua_pop(from, 2);
+                    return -1;
+                }
+                lua_rawset(to, -3);
+                lua_pop(from, 1);
+            }
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/* Takes the next task and pushes a copy of it to the stack of the worker,
+ * returns its index or -1 if there's none left. If the task can't be copied
+ * the pool fails and the error message is pushed instead.
+ */
+static int pool_take(struct worker *w) {
+    int i;
+    struct pool *p = w->pool;
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&p->lock);
+#endif /* HAVE_PTHREAD */
+    if (p->failed || p->next >= p->ntasks)
+        i = -1;
+    else {
+        i = p->next++;
+        lua_rawgeti(p->L, p->tasks, i + 1);
+        if (0 != copy_value(p->L, -1, w->L, 0)) {
+            lua_pushfstring(w->L, "task %d can't be copied", i + 1);
+            w->failed = p->failed = 1;
+            i = -1;
+        }
+        lua_pop(p->L, 1);
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&p->lock);
+#endif /* HAVE_PTHREAD */
+    return i;
+}
+
+static void pool_fail(struct pool *p) {
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&p->lock);
+#endif /* HAVE_PTHREAD */
+    p->failed = 1;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&p->lock);
+#endif /* HAVE_PTHREAD */
+}
+
+/* Runs tasks until there are none left. The arguments of a task are the
+ * elements of its table, the first result and the index of the task are
+ * appended to the results and indexes tables. On error the message is left on
+ * the stack.
+ */
+static void *worker_run(void *arg) {
+    int i, n, nargs;
+    struct worker *w = arg;
+    lua_State *L = w->L;
+
+    while (-1 != (i = pool_take(w))) {
+        lua_pushvalue(L, W_FUNCTION);
+        lua_insert(L, -2);
+        n = lua_objlen(L, -1);
+        if (!lua_checkstack(L, n)) {
+            lua_pushliteral(L, "too many arguments");
+            w->failed = 1;
+            pool_fail(w->pool);
+            break;
+        }
+        for (nargs = 1; nargs <= n; nargs++)
+            lua_rawgeti(L, -nargs, nargs);
+        lua_remove(L, -(n + 1));
+        if (0 != lua_pcall(L, n, 1, 0)) {
+            w->failed = 1;
+            pool_fail(w->pool);
+            break;
+        }
+        w->ndone++;
+        lua_rawseti(L, W_RESULTS, w->ndone);
+        lua_pushinteger(L, i + 1);
+        lua_rawseti(L, W_INDICES, w->ndone);
+    }
+    return NULL;
+}
+
+/* Creates the state of a worker: the standard libraries, the package paths of
+ * the caller, the prelude and the function. The tasks are copied one by one
+ * when they're taken.
+ */
+static const char *worker_init(lua_State *L, struct worker *w, const char *code,
+        size_t len, const char *prelude) {
+    lua_State *WL;
+
+    if (NULL == (w->L = WL = luaL_newstate()))
+        return "not enough memory";
+    luaL_openlibs(WL);
+
+    lua_getglobal(WL, "package");
+    lua_getglobal(L, "package");
+    if (lua_istable(L, -1) && lua_istable(WL, -1)) {
+        lua_getfield(L, -1, "path");
+        copy_value(L, -1, WL, 0);
+        lua_setfield(WL, -2, "path");
+        lua_getfield(L, -2, "cpath");
+        copy_value(L, -1, WL, 0);
+        lua_setfield(WL, -2, "cpath");
+        lua_pop(L, 2);
+    }
+    lua_pop(L, 1);
+    lua_pop(WL, 1);
+
+    if (prelude && 0 != luaL_dostring(WL, prelude))
+        return lua_tostring(WL, -1);
+    lua_settop(WL, 0);
+
+    if (0 != luaL_loadbuffer(WL, code, len, "=worker") || 0 != lua_pcall(WL, 0, 1, 0))
+        return lua_tostring(WL, -1);
+    if (!lua_isfunction(WL, W_FUNCTION))
+        return "code doesn't return a function";
+
+    lua_newtable(WL);
+    lua_newtable(WL);
+    return NULL;
+}
+
+static void workers_close(struct worker *w, int n) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (w[i].L)
+            lua_close(w[i].L);
+    }
+    free(w);
+}
+
+/* pool.run(code, tasks, workers, prelude) */
+static int pool_run(lua_State *L) {
+    int i, j, n, index, nworkers;
+    size_t len;
+    const char *code, *prelude, *errmsg;
+    struct pool p;
+    struct worker *w;
+
+    code = luaL_checklstring(L, 1, &len);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    nworkers = luaL_optint(L, 3, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    prelude = luaL_optstring(L, 4, NULL);
+    if (nworkers < 1 || nworkers > POOL_MAX)
+        return luaL_argerror(L, 3, "invalid number of workers");
+
+    n = lua_objlen(L, 2);
+    for (i = 1; i <= n; i++) {
+        lua_rawgeti(L, 2, i);
+        if (!lua_istable(L, -1))
+            return luaL_argerror(L, 2, "tasks must be tables");
+        lua_pop(L, 1);
+    }
+    if (nworkers > n)
+        nworkers = n > 0 ? n : 1;
+#ifndef HAVE_PTHREAD
+    /* Without threads the tasks run one after the other. */
+    nworkers = 1;
+#endif /* !HAVE_PTHREAD */
+
+    if (NULL == (w = calloc(nworkers, sizeof(struct worker))))
+        return luaL_error(L, "not enough memory");
+    p.L = L;
+    p.tasks = 2;
+    p.ntasks = n;
+    p.next = 0;
+    p.failed = 0;
+    for (i = 0; i < nworkers; i++) {
+        w[i].pool = &p;
+        if (NULL != (errmsg = worker_init(L, &w[i], code, len, prelude))) {
+            lua_pushstring(L, errmsg);
+            workers_close(w, nworkers);
+            return lua_error(L);
+        }
+    }
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init(&p.lock, NULL);
+    for (i = 0; i < nworkers; i++)
+        w[i].started = (0 == pthread_create(&w[i].thread, NULL, worker_run, &w[i]));
+    for (i = 0; i < nworkers; i++) {
+        if (w[i].started)
+            pthread_join(w[i].thread, NULL);
+        else
+            worker_run(&w[i]);
+    }
+    pthread_mutex_destroy(&p.lock);
+#else
+    worker_run(&w[0]);
+#endif /* HAVE_PTHREAD */
+
+    /* Collect the results, the first error wins. */
+    lua_createtable(L, n, 0);
+    for (i = 0; i < nworkers; i++) {
+        lua_State *WL = w[i].L;
+
+        if (w[i].failed) {
+            if (0 != copy_value(WL, -1, L, 0))
+                lua_pushliteral(L, "worker failed");
+            workers_close(w, nworkers);
+            return lua_error(L);
+        }
+        for (j = 1; j <= w[i].ndone; j++) {
+            lua_rawgeti(WL, W_INDICES, j);
+            index = lua_tointeger(WL, -1);
+            lua_rawgeti(WL, W_RESULTS, j);
+            if (!lua_isnil(WL, -1)) {
+                if (0 != copy_value(WL, -1, L, 0)) {
+                    workers_close(w, nworkers);
+                    return luaL_error(L, "result of task %d can't be copied", index);
+                }
+                lua_rawseti(L, -2, index);
+            }
+            lua_pop(WL, 2);
+        }
+    }
+    workers_close(w, nworkers);
+    return 1;
+}
+
+/* pool.cpus() returns the number of online processors. */
+static int pool_cpus(lua_State *L) {
+    lua_pushinteger(L, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    return 1;
+}
+
+static const struct luaL_reg pool_global[] = {
+    {"run", pool_run},
+    {"cpus", pool_cpus},
+    {NULL, NULL}
+};
+
+LUALIB_API int luaopen_chess_pool(lua_State *L) {
+    luaL_register(L, "chess.pool", pool_global);
+
+    /* Push version */
+    lua_pushliteral(L, "_VERSION");
+    lua_pushstring(L, PACKAGE_NAME "-" VERSION);
+    lua_settable(L, -3);
+
+    /* Push whether the workers run in threads */
+    lua_pushliteral(L, "_THREADS");
+#ifdef HAVE_PTHREAD
+    lua_pushboolean(L, 1);
+#else
+    lua_pushboolean(L, 0);
+#endif /* HAVE_PTHREAD */
+    lua_settable(L, -3);
+
+    return 1;
+}
@@ -0,0 +1,637 @@
+/* Position index over binary game databases for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* File layout, all integers are little endian:
+ *
+ *   header:    "LCHESSIX" version:u32 ngames:u32 npositions:u64 nmaterial:u64
+ *   positions: key:u64 game:u32 ply:u32 [npositions]
+ *   material:  signature:u64 game:u32 ply:u32 [nmaterial]
+ *
+ * Both tables are sorted by key, game and ply so a query is a binary search
+ * followed by a scan of the matching run. The key of a position is the
+ * Zobrist key of the board without an en passant file no pawn can capture on,
+ * its signature counts the pieces other than kings of both sides in four bits
+ * each. A game appears in the material table once for every signature it
+ * reaches, with the first ply it's reached at. Games and plies start from 1
+ * and 0 so that db:replay(game, board, ply) sets the position up.
+ */
+
+#include <errno.h>
+#include <limits.h> /* for INT_MAX */
+#include <stdio.h> /* for FILE */
+#include <stdlib.h> /* for malloc, realloc, free, qsort */
+#include <string.h> /* for memcmp, memcpy, strchr, strerror */
+
+#include "lua.h"
+#include "lauxlib.h"
+
+#include "bitboard.h"
+#include "board.h"
+#include "db.h"
+
+/* Prototypes */
+void posindex_open(lua_State *L);
+
+#define IX_MAGIC "LCHESSIX"
+#define IX_VERSION 2
+#define IX_HEADER_SIZE 32
+#define IX_ENTRY_SIZE 16
+
+/* Default memory used by the builder for the entries of both tables. */
+#define IX_MEMORY (64 << 20)
+/* Fewest entries of a sorted run. */
+#define IX_RUN_MIN 16
+/* Entries read from a run at a time while merging. */
+#define IX_MERGE_BUF 256
+
+struct posindex {
+    const unsigned char *data;
+    size_t size;
+    int mapped;
+    unsigned int ngames;
+    U64 npositions;
+    U64 nmaterial;
+    const unsigned char *positions;
+    const unsigned char *material;
+};
+
+struct ixentry {
+    U64 key;
+    unsigned int game;
+    unsigned int ply;
+};
+
+/* Sorted run spilled to the temporary file of a table, offsets are in
+ * entries.
+ */
+struct ixrun {
+    U64 offset;
+    size_t n;
+};
+
+/* Entries collected by the builder. At most limit entries are kept in memory,
+ * when they fill up they're sorted and spilled to a temporary file as a run,
+ * the runs are merged when the table is written.
+ */
+struct ixtable {
+    struct ixentry *entries;
+    size_t n;
+    size_t nalloc;
+    size_t limit;
+    U64 total;
+    FILE *spill;
+    struct ixrun *runs;
+    size_t nruns;
+    size_t runalloc;
+};
+
+/* Reads a run back in blocks while merging. */
+struct ixcursor {
+    U64 next;
+    size_t left;
+    size_t pos;
+    size_t len;
+    struct ixentry head;
+    unsigned char buf[IX_MERGE_BUF * IX_ENTRY_SIZE];
+};
+
+/* Zobrist key of the board which counts the en passant file only if a pawn of
+ * the side to move stands beside the pawn which moved two squares, like the
+ * Polyglot key, so that positions after double pushes match the same FEN with
+ * a "-" en passant field.
+ */
+static U64 position_key(const struct board *b) {
+    int sq;
+    U64 pawns;
+
+    if (-1 == b->ep)
+        return b->key;
+    sq = (WHITE == b->side) ? b->ep - 8 : b->ep + 8;
+    pawns = b->pieces[b->side - 1][PAWN - 1];
+    if ((FILE(sq) > 0 && (pawns & (1ULL << (sq - 1))))
+            || (FILE(sq) < 7 && (pawns & (1ULL << (sq + 1)))))
+        return b->key;
+    return b->key ^ zobrist_ep[FILE(b->ep)];
+}
+
+/* Counts of pawns, knights, bishops, rooks and queens, white first. */
+static U64 material_signature(const struct board *b) {
+    int side, piece;
+    U64 sig = 0;
+
+    for (side = 0; side < 2; side++) {
+        for (piece = 0; piece < 5; piece++) {
+            int n = popcount(b->pieces[side][piece]);
+            sig |= (U64)(n > 15 ? 15 : n) << (4 * (side * 5 + piece));
+        }
+    }
+    return sig;
+}
+
+/* Parses a material string like "KRPkr", returns -1 if it's invalid. */
+static int parse_material(const char *s, U64 *sig) {
+    static const char letters[] = "PNBRQpnbrq";
+    const char *p;
+    unsigned int counts[10] = {0};
+    int i;
+
+    *sig = 0;
+    for (; *s; s++) {
+        if ('K' == *s || 'k' == *s)
+            continue;
+        if (NULL == (p = strchr(letters, *s)))
+            return -1;
+        if (15 == counts[p - letters])
+            return -1;
+        counts[p - letters]++;
+    }
+    for (i = 0; i < 10; i++)
+        *sig |= (U64)counts[i] << (4 * i);
+    return 0;
+}
+
+static int entry_cmp(const void *a, const void *b) {
+    const struct ixentry *x = a, *y = b;
+
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    if (x->game != y->game)
+        return x->game < y->game ? -1 : 1;
+    if (x->ply != y->ply)
+        return x->ply < y->ply ? -1 : 1;
+    return 0;
+}
+
+static int table_write(FILE *fp, const struct ixtable *t) {
+    size_t i;
+    unsigned char buf[IX_ENTRY_SIZE];
+
+    for (i = 0; i < t->n; i++) {
+        put_u64(buf, t->entries[i].key);
+        put_u32(buf + 8, t->entries[i].game);
+        put_u32(buf + 12, t->entries[i].ply);
+        if (1 != fwrite(buf, sizeof(buf), 1, fp))
+            return -1;
+    }
+    return 0;
+}
+
+/* Sorts the entries in memory and appends them to the temporary file as a
+ * run.
+ */
+static int table_spill(struct ixtable *t) {
+    if (NULL == t->spill && NULL == (t->spill = tmpfile()))
+        return -1;
+    if (t->nruns == t->runalloc) {
+        size_t runalloc = t->runalloc ? 2 * t->runalloc : 16;
+        struct ixrun *runs = realloc(t->runs, runalloc * sizeof(struct ixrun));
+        if (NULL == runs)
+            return -1;
+        t->runs = runs;
+        t->runalloc = runalloc;
+    }
+    qsort(t->entries, t->n, sizeof(struct ixentry), entry_cmp);
+    if (0 != table_write(t->spill, t))
+        return -1;
+    t->runs[t->nruns].offset = t->total - t->n;
+    t->runs[t->nruns].n = t->n;
+    t->nruns++;
+    t->n = 0;
+    return 0;
+}
+
+static int table_add(struct ixtable *t, U64 key, unsigned int game, unsigned int ply) {
+    if (t->n == t->limit && 0 != table_spill(t))
+        return -1;
+    if (t->n == t->nalloc) {
+        size_t nalloc = t->nalloc ? 2 * t->nalloc : 4096;
+        struct ixentry *entries;
+
+        if (nalloc > t->limit)
+            nalloc = t->limit;
+        if (NULL == (entries = realloc(t->entries, nalloc * sizeof(struct ixentry))))
+            return -1;
+        t->entries = entries;
+        t->nalloc = nalloc;
+    }
+    t->entries[t->n].key = key;
+    t->entries[t->n].game = game;
+    t->entries[t->n].ply = ply;
+    t->n++;
+    t->total++;
+    return 0;
+}
+
+static void table_free(struct ixtable *t) {
+    free(t->entries);
+    free(t->runs);
+    if (NULL != t->spill)
+        fclose(t->spill);
+}
+
+/* Moves the cursor to the next entry of its run, returns 0 when the run is
+ * exhausted and -1 on error.
+ */
+static int cursor_next(FILE *spill, struct ixcursor *c) {
+    const unsigned char *e;
+
+    if (++c->pos >= c->len) {
+        if (0 == c->left)
+            return 0;
+        c->len = c->left < IX_MERGE_BUF ? c->left : IX_MERGE_BUF;
+        if (0 != fseek(spill, (long)(c->next * IX_ENTRY_SIZE), SEEK_SET)
+                || c->len != fread(c->buf, IX_ENTRY_SIZE, c->len, spill))
+            return -1;
+        c->next += c->len;
+        c->left -= c->len;
+        c->pos = 0;
+    }
+    e = c->buf + c->pos * IX_ENTRY_SIZE;
+    c->head.key = get_u64(e);
+    c->head.game = get_u32(e + 8);
+    c->head.ply = get_u32(e + 12);
+    return 1;
+}
+
+/* Merges the runs of the table into fp. The runs are few, one for every limit
+ * entries, so the smallest head is found by a scan.
+ */
+static int table_merge(FILE *fp, struct ixtable *t) {
+    size_t i, live, best;
+    int ret;
+    struct ixcursor *cursors;
+
+    if (NULL == (cursors = malloc(t->nruns * sizeof(struct ixcursor))))
+        return -1;
+    ret = 0;
+    live = 0;
+    for (i = 0; i < t->nruns; i++) {
+        struct ixcursor *c = cursors + live;
+
+        c->next = t->runs[i].offset;
+        c->left = t->runs[i].n;
+        c->pos = c->len = 0;
+        switch (cursor_next(t->spill, c)) {
+            case -1:
+                ret = -1;
+                goto done;
+            case 1:
+                live++;
+                break;
+        }
+    }
+
+    while (live > 0) {
+        best = 0;
+        for (i = 1; i < live; i++) {
+            if (entry_cmp(&cursors[i].head, &cursors[best].head) < 0)
+                best = i;
+        }
+        if (1 != fwrite(cursors[best].buf + cursors[best].pos * IX_ENTRY_SIZE,
+                    IX_ENTRY_SIZE, 1, fp)) {
+            ret = -1;
+            break;
+        }
+        switch (cursor_next(t->spill, cursors + best)) {
+            case -1:
+                ret = -1;
+                goto done;
+            case 0:
+                cursors[best] = cursors[--live];
+                break;
+        }
+    }
+done:
+    free(cursors);
+    return ret;
+}
+
+/* Writes the entries of the table sorted, merging the spilled runs if there
+ * are any.
+ */
+static int table_finish(FILE *fp, struct ixtable *t) {
+    if (NULL == t->spill) {
+        qsort(t->entries, t->n, sizeof(struct ixentry), entry_cmp);
+        return table_write(fp, t);
+    }
+    if (t->n > 0 && 0 != table_spill(t))
+        return -1;
+    /* The entries aren't needed anymore, make room for the cursors. */
+    free(t->entries);
+    t->entries = NULL;
+    t->nalloc = 0;
+    return table_merge(fp, t);
+}
+
+/* Replays every game and collects the keys and signatures of its positions.
+ * Returns the number of the game which failed or 0.
+ */
+static unsigned int collect(const struct db *db, struct ixtable *positions,
+        struct ixtable *material, const char **errmsg) {
+    unsigned int i, ply;
+    U64 sig, last;
+    struct board b;
+    struct dbgame g;
+
+    b.hsize = 0;
+    b.history = NULL;
+    b.side = WHITE;
+    b.li_king = 4; /* e1 */
+    b.li_rook[0] = 7; /* h1 */
+    b.li_rook[1] = 0; /* a1 */
+
+    for (i = 0; i < db->ngames; i++) {
+        if (0 != db_game(db, i, &g)) {
+            *errmsg = "game is corrupt";
+            break;
+        }
+        if (-1 == db_replay(&b, &g, 0, errmsg))
+            break;
+        last = 0;
+        for (ply = 0; ; ply++) {
+            if (0 != table_add(positions, position_key(&b), i + 1, ply))
+                goto syserr;
+            sig = material_signature(&b);
+            if ((0 == ply || sig != last) && 0 != table_add(material, sig, i + 1, ply))
+                goto syserr;
+            last = sig;
+            if (ply == g.nmoves)
+                break;
+            if (-1 == db_step(&b, &g, ply, errmsg))
+                goto fail;
+        }
+    }
+    free(b.history);
+    return (i < db->ngames) ? i + 1 : 0;
+
+syserr:
+    *errmsg = strerror(errno);
+fail:
+    free(b.history);
+    return i + 1;
+}
+
+/* chess.board.buildindex(db, filename, memory) indexes the positions of every
+ * game of the database, using about memory bytes for the entries. Returns the
+ * number of positions or nil and an error message.
+ */
+static int posindex_build(lua_State *L) {
+    unsigned int failed;
+    int ok;
+    size_t limit;
+    lua_Number memory;
+    const char *filename, *errmsg;
+    unsigned char header[IX_HEADER_SIZE];
+    FILE *fp;
+    struct db *db;
+    struct ixtable positions, material;
+
+    db = db_check(L, 1);
+    filename = luaL_checkstring(L, 2);
+    memory = luaL_optnumber(L, 3, IX_MEMORY);
+
+    /* The memory is shared by the two tables. */
+    memory /= 2 * sizeof(struct ixentry);
+    if (!(memory >= IX_RUN_MIN))
+        limit = IX_RUN_MIN;
+    else if (memory >= (lua_Number)((size_t)-1 / sizeof(struct ixentry)))
+        limit = (size_t)-1 / sizeof(struct ixentry);
+    else
+        limit = (size_t)memory;
+    memset(&positions, 0, sizeof(positions));
+    memset(&material, 0, sizeof(material));
+    positions.limit = material.limit = limit;
+
+    if (0 != (failed = collect(db, &positions, &material, &errmsg))) {
+        table_free(&positions);
+        table_free(&material);
+        return luaL_error(L, "game %d: %s", failed, errmsg);
+    }
+
+    memcpy(header, IX_MAGIC, 8);
+    put_u32(header + 8, IX_VERSION);
+    put_u32(header + 12, db->ngames);
+    put_u64(header + 16, positions.total);
+    put_u64(header + 24, material.total);
+
+    ok = (NULL != (fp = fopen(filename, "wb")));
+    ok = ok && 1 == fwrite(header, sizeof(header), 1, fp);
+    ok = ok && 0 == table_finish(fp, &positions) && 0 == table_finish(fp, &material);
+    if (NULL != fp)
+        ok = (0 == fclose(fp)) && ok;
+    table_free(&positions);
+    table_free(&material);
+
+    if (!ok) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "%s: %s", filename, strerror(errno));
+        return 2;
+    }
+    lua_pushnumber(L, (lua_Number)positions.total);
+    return 1;
+}
+
+/* chess.board.openindex(filename) returns the index or nil and an error
+ * message.
+ */
+static int posindex_new(lua_State *L) {
+    const char *filename;
+    struct posindex *ix;
+
+    filename = luaL_checkstring(L, 1);
+    ix = (struct posindex *)lua_newuserdata(L, sizeof(struct posindex));
+    ix->data = NULL;
+    luaL_getmetatable(L, POSINDEX_T);
+    lua_setmetatable(L, -2);
+
+    switch (db_map(filename, IX_HEADER_SIZE, &ix->data, &ix->size, &ix->mapped)) {
+        case -1:
+            lua_pushnil(L);
+            lua_pushfstring(L, "%s: %s", filename, strerror(errno));
+            return 2;
+        case 1:
+            lua_pushnil(L);
+            lua_pushfstring(L, "%s: not a position index", filename);
+            return 2;
+    }
+
+    ix->ngames = get_u32(ix->data + 12);
+    ix->npositions = get_u64(ix->data + 16);
+    ix->nmaterial = get_u64(ix->data + 24);
+    if (0 != memcmp(ix->data, IX_MAGIC, 8) || IX_VERSION != get_u32(ix->data + 8)
+            || ix->npositions > (ix->size - IX_HEADER_SIZE) / IX_ENTRY_SIZE
+            || ix->nmaterial > (ix->size - IX_HEADER_SIZE) / IX_ENTRY_SIZE - ix->npositions) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "%s: not a position index", filename);
+        return 2;
+    }
+    ix->positions = ix->data + IX_HEADER_SIZE;
+    ix->material = ix->positions + ix->npositions * IX_ENTRY_SIZE;
+    return 1;
+}
+
+static inline struct posindex *check_posindex(lua_State *L, int narg) {
+    struct posindex *ix;
+
+    ix = luaL_checkudata(L, narg, POSINDEX_T);
+    if (NULL == ix->data)
+        luaL_argerror(L, narg, "index is closed");
+    return ix;
+}
+
+/* Index of the first entry whose key isn't less than key. */
+static U64 lower_bound(const unsigned char *table, U64 n, U64 key) {
+    U64 lo = 0, hi = n, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (get_u64(table + mid * IX_ENTRY_SIZE) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Pushes the arrays of games and plies of at most limit entries with key. */
+static int push_matches(lua_State *L, const unsigned char *table, U64 n, U64 key,
+        int limit) {
+    int i;
+    U64 j;
+    const unsigned char *e;
+
+    lua_newtable(L);
+    lua_newtable(L);
+    for (i = 0, j = lower_bound(table, n, key); i < limit && j < n; i++, j++) {
+        e = table + j * IX_ENTRY_SIZE;
+        if (get_u64(e) != key)
+            break;
+        lua_pushinteger(L, get_u32(e + 8));
+        lua_rawseti(L, -3, i + 1);
+        lua_pushinteger(L, get_u32(e + 12));
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 2;
+}
+
+/* Loads the position at narg, a board or a FEN, into the board on the stack of
+ * the caller and returns it.
+ */
+static const struct board *check_position(lua_State *L, int narg, struct board *tmp) {
+    size_t len, errpos;
+    const char *fen, *errmsg;
+
+    if (LUA_TSTRING != lua_type(L, narg))
+        return db_check_board(L, narg);
+    fen = lua_tolstring(L, narg, &len);
+    tmp->hsize = 0;
+    tmp->history = NULL;
+    tmp->side = WHITE;
+    tmp->li_king = 4; /* e1 */
+    tmp->li_rook[0] = 7; /* h1 */
+    tmp->li_rook[1] = 0; /* a1 */
+    if (0 != board_loadfen(tmp, fen, len, &errpos, &errmsg))
+        luaL_argerror(L, narg, lua_pushfstring(L, "invalid fen: %s at byte %d",
+                    errmsg, (int)errpos + 1));
+    return tmp;
+}
+
+/* ix:find(position, limit) returns arrays of the games reaching the position,
+ * a board or a FEN, and the plies they reach it at.
+ */
+static int posindex_find(lua_State *L) {
+    int limit;
+    struct board tmp;
+    const struct board *b;
+    struct posindex *ix;
+
+    ix = check_posindex(L, 1);
+    b = check_position(L, 2, &tmp);
+    limit = luaL_optint(L, 3, INT_MAX);
+    return push_matches(L, ix->positions, ix->npositions, position_key(b), limit);
+}
+
+/* ix:material(position, limit) returns arrays of the games reaching the
+ * material of the position, a board, a FEN or piece letters like "KRPkr", and
+ * the first plies they reach it at.
+ */
+static int posindex_material(lua_State *L) {
+    int limit;
+    U64 sig;
+    const char *s;
+    struct board tmp;
+    struct posindex *ix;
+
+    ix = check_posindex(L, 1);
+    s = (LUA_TSTRING == lua_type(L, 2)) ? lua_tostring(L, 2) : NULL;
+    if (NULL != s && NULL == strchr(s, '/')) {
+        if (0 != parse_material(s, &sig))
+            return luaL_argerror(L, 2, "invalid material");
+    }
+    else
+        sig = material_signature(check_position(L, 2, &tmp));
+    limit = luaL_optint(L, 3, INT_MAX);
+    return push_matches(L, ix->material, ix->nmaterial, sig, limit);
+}
+
+/* ix:count() returns the number of indexed positions. */
+static int posindex_count(lua_State *L) {
+    lua_pushnumber(L, (lua_Number)check_posindex(L, 1)->npositions);
+    return 1;
+}
+
+static int posindex_close(lua_State *L) {
+    struct posindex *ix;
+
+    ix = luaL_checkudata(L, 1, POSINDEX_T);
+    if (NULL != ix->data) {
+        db_unmap(ix->data, ix->size, ix->mapped);
+        ix->data = NULL;
+    }
+    return 0;
+}
+
+static const struct luaL_reg posindex_methods[] = {
+    {"__gc", posindex_close},
+    {"__len", posindex_count},
+    {"close", posindex_close},
+    {"count", posindex_count},
+    {"find", posindex_find},
+    {"material", posindex_material},
+    {NULL, NULL}
+};
+
+void posindex_open(lua_State *L) {
+    /* Register POSINDEX_T metatable */
+    luaL_newmetatable(L, POSINDEX_T);
+    luaL_register(L, NULL, posindex_methods);
+    lua_pushliteral(L, "__index");
+    lua_pushvalue(L, -2);
+    lua_settable(L, -3);
+    lua_pop(L, 1);
+
+    /* Push openindex and buildindex to the module table */
+    lua_pushliteral(L, "openindex");
+    lua_pushcfunction(L, posindex_new);
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "buildindex");
+    lua_pushcfunction(L, posindex_build);
+    lua_settable(L, -3);
+}
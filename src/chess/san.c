@@ -0,0 +1,155 @@
+/* SAN move resolution for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stddef.h> /* for size_t */
+
+#include "bitboard.h"
+#include "board.h"
+
+static inline int san_piece(char c) {
+    switch (c) {
+        case 'N':
+            return KNIGHT;
+        case 'B':
+            return BISHOP;
+        case 'R':
+            return ROOK;
+        case 'Q':
+            return QUEEN;
+        case 'K':
+            return KING;
+        default:
+            return 0;
+    }
+}
+
+/* Returns the castling side of san, 1 for kingside, 2 for queenside and 0 if
+ * it's not a castling move. Both O-O and 0-0 are accepted.
+ */
+static inline int san_castle(const char *san, size_t len) {
+    char o;
+
+    if (len < 3)
+        return 0;
+    o = san[0];
+    if (('O' != o && '0' != o) || '-' != san[1] || o != san[2])
+        return 0;
+    if (3 == len)
+        return 1;
+    if (5 == len && '-' == san[3] && o == san[4])
+        return 2;
+    return 0;
+}
+
+/* Resolves the move in Standard Algebraic Notation against the legal moves of
+ * the position. Check and annotation suffixes are ignored, long algebraic
+ * forms like Ng1-f3 are accepted as well. Returns the move, on failure 0 is
+ * returned and errmsg is set to a description of the error.
+ */
+int board_parse_san(const struct board *b, const char *san, size_t len,
+        const char **errmsg) {
+    int i, n, m, found, castle, piece, promote, ffile, frank, to;
+    int moves[MAX_MOVES];
+
+    /* Strip check and annotation suffixes */
+    while (len > 0 && ('+' == san[len - 1] || '#' == san[len - 1]
+                || '!' == san[len - 1] || '?' == san[len - 1]))
+        len--;
+
+    piece = PAWN;
+    promote = 0;
+    ffile = frank = to = -1;
+    castle = san_castle(san, len);
+    if (!castle) {
+        if (len > 0 && 0 != (piece = san_piece(san[0]))) {
+            san++;
+            len--;
+        }
+        else
+            piece = PAWN;
+
+        /* Promotion, both e8=Q and e8Q */
+        if (PAWN == piece && len > 0 && (promote = san_piece(san[len - 1]))) {
+            if (KING == promote) {
+                *errmsg = "invalid promotion";
+                return 0;
+            }
+            len--;
+            if (len > 0 && '=' == san[len - 1])
+                len--;
+        }
+
+        /* Destination square */
+        if (len < 2 || san[len - 2] < 'a' || san[len - 2] > 'h'
+                || san[len - 1] < '1' || san[len - 1] > '8') {
+            *errmsg = "invalid destination square";
+            return 0;
+        }
+        to = (san[len - 1] - '1') * 8 + (san[len - 2] - 'a');
+        len -= 2;
+
+        /* Capture or long algebraic separator */
+        if (len > 0 && ('x' == san[len - 1] || ':' == san[len - 1] || '-' == san[len - 1]))
+            len--;
+
+        /* Disambiguation */
+        for (i = 0; i < (int)len; i++) {
+            if (san[i] >= 'a' && san[i] <= 'h' && -1 == ffile)
+                ffile = san[i] - 'a';
+            else if (san[i] >= '1' && san[i] <= '8' && -1 == frank)
+                frank = san[i] - '1';
+            else {
+                *errmsg = "invalid move";
+                return 0;
+            }
+        }
+        /* Pawn moves without a file are pushes */
+        if (PAWN == piece && -1 == ffile)
+            ffile = FILE(to);
+    }
+
+    n = board_generate(b, moves, MAX_MOVES, 1);
+    found = 0;
+    for (i = 0; i < n; i++) {
+        m = moves[i];
+        if (castle) {
+            if (!(m & CASTLING) || (1 == castle) != (6 == FILE(TOSQ(m))))
+                continue;
+        }
+        else {
+            if ((m & CASTLING) || TOSQ(m) != to || b->cboard[FROMSQ(m)] != piece)
+                continue;
+            if (-1 != ffile && FILE(FROMSQ(m)) != ffile)
+                continue;
+            if (-1 != frank && RANK(FROMSQ(m)) != frank)
+                continue;
+            if (PROMOTE_PIECE(m) != promote)
+                continue;
+        }
+        if (found) {
+            *errmsg = "ambiguous move";
+            return 0;
+        }
+        found = m;
+    }
+
+    if (!found)
+        *errmsg = "illegal move";
+    return found;
+}
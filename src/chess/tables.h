@@ -0,0 +1,72 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LUACHESS_GUARD_TABLES_H
+#define LUACHESS_GUARD_TABLES_H 1
+
+#include <stdlib.h> /* for abs */
+
+#include "bitboard.h"
+#include "once.h"
+
+#define FILE_A 0x0101010101010101ULL
+#define FILE_H 0x8080808080808080ULL
+#define RANK_1 0x00000000000000FFULL
+#define RANK_2 0x000000000000FF00ULL
+#define RANK_3 0x0000000000FF0000ULL
+#define RANK_6 0x0000FF0000000000ULL
+#define RANK_7 0x00FF000000000000ULL
+#define RANK_8 0xFF00000000000000ULL
+
+TABLES_API extern const U64 PAWN_ATTACKS[2][64];
+TABLES_API extern const U64 KNIGHT_ATTACKS[64];
+TABLES_API extern const U64 KING_ATTACKS[64];
+
+/* Directions, index of RAYS. */
+#define NORTH 0
+#define NORTHEAST 1
+#define EAST 2
+#define SOUTHEAST 3
+#define SOUTH 4
+#define SOUTHWEST 5
+#define WEST 6
+#define NORTHWEST 7
+#define OPPOSITE(dir) (((dir) + 4) & 7)
+
+/* Geometry, built by tables_init(). */
+TABLES_API extern U64 RAYS[8][64];     /* squares from sq to the edge, sq excluded */
+TABLES_API extern U64 BETWEEN[64][64]; /* squares strictly between aligned squares */
+TABLES_API extern U64 LINE[64][64];    /* whole line through aligned squares */
+TABLES_API extern unsigned char DISTANCE[64][64]; /* Chebyshev (king move) distance */
+TABLES_API extern U64 RANK_MASK[64];
+TABLES_API extern U64 FILE_MASK[64];
+TABLES_API extern U64 DIAGONAL_MASK[64];     /* a1-h8 direction */
+TABLES_API extern U64 ANTIDIAGONAL_MASK[64]; /* h1-a8 direction */
+
+/* Manhattan (rook move) distance */
+#define MANHATTAN(a, b) (abs(((a) >> 3) - ((b) >> 3)) + abs(((a) & 7) - ((b) & 7)))
+
+void tables_init(void);
+
+/* Builds the slider, geometry and Zobrist tables unless they're built already,
+ * returns how many times they were built.
+ */
+TABLES_API int tables_setup(void);
+
+#endif /* LUACHESS_GUARD_TABLES_H */
@@ -0,0 +1,53 @@
+/* Zobrist keys for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "bitboard.h"
+#include "zobrist.h"
+
+U64 zobrist_piece[2][6][64];
+U64 zobrist_side;
+U64 zobrist_flag[16];
+U64 zobrist_ep[8];
+
+/* xorshift64* generator, the seed is fixed so that keys are the same for
+ * every run.
+ */
+static U64 rand64(U64 *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+void zobrist_init(void) {
+    int i, j, k;
+    U64 state = 0x9E3779B97F4A7C15ULL;
+
+    for (i = 0; i < 2; i++)
+        for (j = 0; j < 6; j++)
+            for (k = 0; k < 64; k++)
+                zobrist_piece[i][j][k] = rand64(&state);
+    zobrist_side = rand64(&state);
+    /* No castling rights means no key so that an empty board has key 0. */
+    zobrist_flag[0] = 0;
+    for (i = 1; i < 16; i++)
+        zobrist_flag[i] = rand64(&state);
+    for (i = 0; i < 8; i++)
+        zobrist_ep[i] = rand64(&state);
+}
@@ -0,0 +1,37 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LUACHESS_GUARD_ZOBRIST_H
+#define LUACHESS_GUARD_ZOBRIST_H 1
+
+#include "bitboard.h"
+#include "once.h"
+
+/* Random keys, the key of a position is the xor of the keys of its pieces,
+ * zobrist_side if black is to move, zobrist_flag[flag] and the key of the
+ * file of the en passant square if there's one.
+ */
+TABLES_API extern U64 zobrist_piece[2][6][64];
+TABLES_API extern U64 zobrist_side;
+TABLES_API extern U64 zobrist_flag[16];
+TABLES_API extern U64 zobrist_ep[8];
+
+void zobrist_init(void);
+
+#endif /* LUACHESS_GUARD_ZOBRIST_H */
@@ -50,6 +50,8 @@ client = {}
 local CR = "\r"
 local LF = "\n"
 --}}}
+--- Number of bytes read from the socket at a time.
+RECV_SIZE = 8192
 --{{{ FICS Interface Variables
 local IVARS_COUNT = 35
 IVARS_PREFIX = "%b"
@@ -150,6 +152,208 @@ function tag_concat(t)
     return tstr
 end --}}}
 --}}}
+--{{{ Line handlers
+-- Handlers of the parser ids, they're called with the client, the line and the
+-- parsed table and return nil and error message on failure. Lines are only
+-- parsed for the ids whose group has callbacks unless always is set.
+local handlers = {}
+
+local function handler(id, group, func, always, wraps)
+    handlers[id] = {group = group, func = func, always = always, wraps = wraps}
+end
+
+-- Runs the callbacks with the elements first to last of parsed.
+local function simple(id, group, first, last)
+    handler(id, group, function (self, line, parsed)
+        self:run_callback("line", group, line)
+        if first then
+            self:run_callback(group, line, unpack(parsed, first, last))
+        else
+            self:run_callback(group, line)
+        end
+    end)
+end
+
+-- Chat may be wrapped by server.
+local function chat(id, group, first, last)
+    handler(id, group, function (self, line, parsed)
+        self._last_wrapping_group = group
+
+        self:run_callback("line", group, line)
+        self:run_callback(group, line, unpack(parsed, first, last))
+    end, false, true)
+end
+
+-- Authentication errors are fatal unless there are callbacks.
+local function fatal(id, group, errmsg)
+    handler(id, group, function (self, line, parsed)
+        self:run_callback("line", group, line)
+        if self.callbacks[group] then
+            self:run_callback(group, line)
+        else
+            error(errmsg)
+        end
+    end, true)
+end
+
+-- Prompts
+handler(parser.PROMPT_LOGIN, "login", function (self, line, parsed)
+    if self.send_ivars and self._ivars_sent == false then
+        local bytes, errmsg = self:send(self:ivars_tostring())
+        if errmsg ~= nil then
+            return nil, errmsg
+        else
+            self._ivars_sent = true
+        end
+
+        -- Send another newline to get login prompt back.
+        bytes, errmsg = self:send ""
+        if errmsg ~= nil then
+            return nil, errmsg
+        end
+    else
+        self:run_callback("line", "login", line)
+        self:run_callback("login", line)
+    end
+end, true)
+simple(parser.PROMPT_PASSWORD, "password")
+simple(parser.PROMPT_SERVER, "prompt", 2, 2)
+
+-- Authentication
+handler(parser.HANDLE_TOO_SHORT, "handle_too_short", function (self, line, parsed)
+    self:run_callback("line", "handle_too_short", line)
+    if self.callbacks["handle_too_short"] then
+        self:run_callback("handle_too_short")
+    else
+        error "handle too short"
+    end
+end, true)
+fatal(parser.HANDLE_TOO_LONG, "handle_too_long", "handle too long")
+fatal(parser.HANDLE_NOT_ALPHA, "handle_not_alpha", "handle not alpha")
+handler(parser.HANDLE_BANNED, "handle_banned", function (self, line, parsed)
+    self:run_callback("line", "handle_banned", line)
+    if self.callbacks["handle_banned"] then
+        self:run_callback("handle_banned", line, parsed[2])
+    else
+        error("handle '" .. parsed[2] .. "' banned")
+    end
+end, true)
+simple(parser.HANDLE_NOT_REGISTERED, "handle_not_registered", 2, 2)
+fatal(parser.PASSWORD_INVALID, "password_invalid", "invalid password")
+handler(parser.PRESS_RETURN, "press_return", function (self, line, parsed)
+    self:run_callback("line", "press_return", line)
+    if self.callbacks["press_return"] then
+        self:run_callback("press_return", line, parsed[2])
+    else
+        self:send""
+    end
+end, true)
+
+-- Session start
+simple(parser.WELCOME, "session_start", 2, 3)
+simple(parser.NEWS, "news", 2, 4)
+simple(parser.MESSAGES, "messages", 2, 3)
+
+-- Notifications
+simple(parser.NOTIFY_INCLUDE, "notify_include", 2, 2)
+simple(parser.NOTIFY_NOTE, "notify_note", 2, 2)
+simple(parser.NOTIFY_ARRIVE, "notify_arrive", 2, 3)
+simple(parser.NOTIFY_DEPART, "notify_depart", 2, 3)
+
+-- Chat
+chat(parser.TELL, "tell", 2, 4)
+chat(parser.CHANTELL, "chantell", 2, 5)
+chat(parser.QTELL, "qtell", 2, 2)
+chat(parser.IT, "it", 1, 3)
+chat(parser.SHOUT, "shout", 1, 3)
+chat(parser.CSHOUT, "cshout", 1, 3)
+chat(parser.ANNOUNCEMENT, "announcement", 1, 2)
+chat(parser.KIBITZ, "kibitz", 1, 5)
+chat(parser.WHISPER, "whisper", 1, 5)
+
+-- Challenge
+handler(parser.CHALLENGE_UPDATE, "challenge", function (self, line, parsed)
+    self:run_callback("line", "challenge", line)
+    if not self.callbacks["challenge"] then return end
+    self.__parse_chunk_game_update = true
+end)
+handler(parser.MATCH_REQUEST, "challenge", function (self, line, parsed)
+    self:run_callback("line", "challenge", line)
+
+    if self.__parse_chunk_game_update then
+        parsed[2].update = true
+    else
+        parsed[2].update = false
+    end
+    self.__parse_chunk_game_update = nil
+
+    if parsed[2].rated == false then
+        -- Don't wait for the next line to call the callback
+        self:run_callback("challenge", line, parsed[3], parsed[4],
+            parsed[2])
+    else
+        self.__parse_chunk_game = parsed[2]
+        self.__parse_chunk_player1 = parsed[3]
+        self.__parse_chunk_player2 = parsed[4]
+    end
+end)
+handler(parser.RATING_CHANGE, "challenge", function (self, line, parsed)
+    self:run_callback("line", "challenge", line)
+    if not self.callbacks["challenge"] then return end
+
+    self.__parse_chunk_game.win = parsed[3]
+    self.__parse_chunk_game.draw = parsed[4]
+    self.__parse_chunk_game.loss = parsed[5]
+end)
+handler(parser.NEWRD, "challenge", function (self, line, parsed)
+    self:run_callback("line", "challenge", line)
+    -- Don't return here because parse chunks must be set to nil.
+
+    self.__parse_chunk_game.newrd = parsed[2]
+    self:run_callback("challenge", line, self.__parse_chunk_player1,
+        self.__parse_chunk_player2, self.__parse_chunk_game)
+    self.__parse_chunk_game = nil
+    self.__parse_chunk_player1 = nil
+    self.__parse_chunk_player2 = nil
+end)
+
+-- Bughouse
+simple(parser.PARTNER_OFFER, "partner", 2, 2)
+
+-- Game start/end
+simple(parser.GAME_START, "game_start", 2, 5)
+simple(parser.GAME_END, "game_end", 2, 6)
+
+-- Style 12
+simple(parser.STYLE12, "style12", 2, 2)
+
+-- Offers
+simple(parser.DRAW, "offer_draw", 2, 2)
+simple(parser.DRAW_ACCEPT, "draw_accept", 2, 2)
+simple(parser.DRAW_DECLINE, "draw_decline", 2, 2)
+simple(parser.ABORT, "offer_abort", 2, 2)
+simple(parser.ABORT_ACCEPT, "abort_accept", 2, 2)
+simple(parser.ABORT_DECLINE, "abort_decline", 2, 2)
+simple(parser.ADJOURN, "offer_adjourn", 2, 2)
+simple(parser.ADJOURN_ACCEPT, "adjourn_accept", 2, 2)
+simple(parser.ADJOURN_DECLINE, "adjourn_decline", 2, 2)
+simple(parser.TAKEBACK, "offer_takeback", 2, 3)
+simple(parser.TAKEBACK_ACCEPT, "takeback_accept", 2, 2)
+simple(parser.TAKEBACK_DECLINE, "takeback_decline", 2, 2)
+
+-- Seeks
+simple(parser.SEEKINFO, "seek", 2, 2)
+simple(parser.SEEKREMOVE, "seekremove", 2, 2)
+simple(parser.SEEKCLEAR, "seekclear")
+
+-- Examined/Observed
+simple(parser.MOVE, "move", 2, 4)
+simple(parser.EXAMINING, "examining", 2, 2)
+
+-- Telnet
+simple(parser.IAC_WILL_ECHO, "iacwillecho")
+simple(parser.IAC_WONT_ECHO, "iacwontecho")
+--}}}
 --{{{ fics.client functions
 --- Create a new fics.client instance.
 -- @param argtable A table which may have the following elements<br />
@@ -184,9 +388,13 @@ function client:new(argtable) --{{{
         _last_sent = 0,
         _seen_magicgstr = false,
         _linebuf = "",
+        _lines = {},
+        _lines_first = 1,
+        _lines_last = 0,
         _empty_lines = 0,
         _got_gresponse = false,
         _last_wrapping_group = nil,
+        _parser = nil,
     }
 
     -- Set necessary interface variables.
@@ -270,6 +478,9 @@ function client:disconnect() --{{{
     self._last_sent = 0
     self._seen_magicgstr = false
     self._linebuf = ""
+    self._lines = {}
+    self._lines_first = 1
+    self._lines_last = 0
     self._empty_lines = 0
     self._got_gresponse = false
     self._last_wrapping_group = nil
@@ -298,7 +509,26 @@ function client:send(data) --{{{
 
     return bytes, errmsg
 end --}}}
+--- Split data received from the server into lines.<br />
+-- Complete lines and prompts are queued for <tt>recvline</tt>, the partial
+-- last line is kept until the rest of it arrives.
+-- @param data Data received from the server.
+-- @return <tt>nil</tt>
+function client:feed(data) --{{{
+    -- Timeseal pings are queued as false.
+    local lines, rest = utils.split_lines(self._linebuf .. data, self.timeseal)
+    local queue, last = self._lines, self._lines_last
+
+    for i=1,#lines do
+        queue[last + i] = lines[i]
+    end
+
+    self._lines_last = last + #lines
+    self._linebuf = rest
+end --}}}
 --- Receive a line from the server.
+-- Reads up to <tt>RECV_SIZE</tt> bytes at a time when no complete line is
+-- queued.
 -- @return The received line, <tt>nil</tt> and error message on failure.
 -- <br/><b>Note:</b><br />
 -- The error message may be <tt>internal</tt> for internal lines like timeseal
@@ -307,27 +537,34 @@ function client:recvline() --{{{
     assert(self.sock ~= nil, "not connected")
 
     self:run_callback("idle", os.time() - self._last_sent)
-    while true do
-        local chunk, errmsg = self.sock:receive(1)
-        if chunk == nil then
+    while self._lines_first > self._lines_last do
+        local data, errmsg, partial = self.sock:receive(RECV_SIZE)
+        data = data or partial
+        if data ~= nil and data ~= "" then self:feed(data) end
+        if errmsg ~= nil and self._lines_first > self._lines_last then
             return nil, errmsg
         end
+    end
 
-        -- fics sends CRLF at the end of every line.
-        if chunk == LF then
-            break
-        elseif chunk ~= CR then
-            self._linebuf = self._linebuf .. chunk
-
-            if parser.prompts:match(self._linebuf) then
-                break
-            end
-        end
+    return self:nextline()
+end --}}}
+--- Take the next line queued by <tt>feed</tt>.
+-- @return The line, <tt>nil</tt> if no line is queued.
+-- <br/><b>Note:</b><br />
+-- <tt>nil</tt> and <tt>internal</tt> are returned for internal lines.
+function client:nextline() --{{{
+    local first = self._lines_first
+    if first > self._lines_last then return nil end
+
+    local line = self._lines[first]
+    self._lines[first] = nil
+    if first == self._lines_last then
+        self._lines_first, self._lines_last = 1, 0
+    else
+        self._lines_first = first + 1
     end
 
-    local line = self._linebuf
-    self._linebuf = ""
-    if self.timeseal and string.find(line, utils.TIMESEAL_MAGICGSTR) then
+    if line == false then
         self._got_gresponse = true
         self:send(utils.TIMESEAL_GRESPONSE)
         return nil, "internal"
@@ -350,6 +587,7 @@ function client:register_callback(group, func) --{{{
         callback_index.key = #self.callbacks[group] + 1
         table.insert(self.callbacks[group], func)
     end
+    self._parser = nil
     return callback_index
 end --}}}
 --- Register a callback
@@ -364,6 +602,7 @@ function client:remove_callback(index) --{{{
     if self.callbacks[index.group] then
         if self.callbacks[index.group][index.key] then
             table.remove(self.callbacks[index.group], index.key)
+            self._parser = nil
             return true
         end
     end
@@ -398,6 +637,28 @@ function client:run_callback(group, ...) --{{{
         end
     end
 end --}}}
+--- Generate the parser of the client.<br />
+-- Only the lines which have callbacks, either in their group or in the
+-- <tt>line</tt> group, and the lines the client handles itself are parsed.
+-- Other lines are passed to the <tt>line</tt> callbacks as unknown. This is
+-- done when a line is parsed after callbacks are registered or removed.
+-- @return <tt>nil</tt>
+function client:generate_parser() --{{{
+    local callbacks = self.callbacks
+    local function wanted(group)
+        return callbacks[group] ~= nil and #callbacks[group] > 0
+    end
+
+    local all, wrap = wanted("line"), wanted("wrap")
+    local p
+    for _, pattern in ipairs(parser.patterns) do
+        local h = handlers[pattern[1]]
+        if all or h.always or (h.wraps and wrap) or wanted(h.group) then
+            if p == nil then p = pattern[2] else p = p + pattern[2] end
+        end
+    end
+    self._parser = p
+end --}}}
 --- Parse a line and call related callback functions.
 -- @param line The line to parse.
 -- @return <tt>true</tt> on success, <tt>nil</tt> and error message on failure.
@@ -420,7 +681,8 @@ function client:parseline(line) --{{{
         end
     end
 
-    local parsed = parser.p:match(line)
+    if self._parser == nil then self:generate_parser() end
+    local parsed = self._parser:match(line)
 
     if not parsed then
         -- Wrap
@@ -433,321 +695,16 @@ function client:parseline(line) --{{{
             self._last_wrapping_group = nil
             self:run_callback("line", nil, line)
         end
-
-    -- Prompts
-    elseif parsed[1] == parser.PROMPT_LOGIN then
-        if self.send_ivars and self._ivars_sent == false then
-            local bytes, errmsg = self:send(self:ivars_tostring())
-            if errmsg ~= nil then
-                return nil, errmsg
-            else
-                self._ivars_sent = true
-            end
-
-            -- Send another newline to get login prompt back.
-            bytes, errmsg = self:send ""
-            if errmsg ~= nil then
-                return nil, errmsg
-            end
-        else
-            self:run_callback("line", "login", line)
-            self:run_callback("login", line)
-        end
         return true
-    elseif parsed[1] == parser.PROMPT_PASSWORD then
-        self:run_callback("line", "password", line)
-        self:run_callback("password", line)
-        return true
-    elseif parsed[1] == parser.PROMPT_SERVER then
-        self:run_callback("line", "prompt", line)
-        self:run_callback("prompt", line, parsed[2])
-        return true
-
-    -- Authentication
-    elseif parsed[1] == parser.HANDLE_TOO_SHORT then
-        self:run_callback("line", "handle_too_short", line)
-        if self.callbacks["handle_too_short"] then
-            self:run_callback("handle_too_short")
-        else
-            error "handle too short"
-        end
-    elseif parsed[1] == parser.HANDLE_TOO_LONG then
-        self:run_callback("line", "handle_too_long", line)
-        if self.callbacks["handle_too_long"] then
-            self:run_callback("handle_too_long", line)
-        else
-            error "handle too long"
-        end
-    elseif parsed[1] == parser.HANDLE_NOT_ALPHA then
-        self:run_callback("line", "handle_not_alpha", line)
-        if self.callbacks["handle_not_alpha"] then
-            self:run_callback("handle_not_alpha", line)
-        else
-            error "handle not alpha"
-        end
-    elseif parsed[1] == parser.HANDLE_BANNED then
-        self:run_callback("line", "handle_banned", line)
-        if self.callbacks["handle_banned"] then
-            self:run_callback("handle_banned", line, parsed[2])
-        else
-            error("handle '" .. parsed[2] .. "' banned")
-        end
-    elseif parsed[1] == parser.HANDLE_NOT_REGISTERED then
-        self:run_callback("line", "handle_not_registered", line)
-        self:run_callback("handle_not_registered", line, parsed[2])
-    elseif parsed[1] == parser.PASSWORD_INVALID then
-        self:run_callback("line", "password_invalid", line)
-        if self.callbacks["password_invalid"] then
-            self:run_callback("password_invalid", line)
-        else
-            error "invalid password"
-        end
-    elseif parsed[1] == parser.PRESS_RETURN then
-        self:run_callback("line", "press_return", line)
-        if self.callbacks["press_return"] then
-            self:run_callback("press_return", line, parsed[2])
-        else
-            self:send""
-        end
-
-    -- Session start
-    elseif parsed[1] == parser.WELCOME then
-        self:run_callback("line", "session_start", line)
-        self:run_callback("session_start", line, parsed[2], parsed[3])
-
-    elseif parsed[1] == parser.NEWS then
-        self:run_callback("line", "news", line)
-        self:run_callback("news", line, parsed[2], parsed[3], parsed[4])
-
-    elseif parsed[1] == parser.MESSAGES then
-        self:run_callback("line", "messages", line)
-        self:run_callback("messages", line, parsed[2], parsed[3])
-
-    -- Notifications
-    elseif parsed[1] == parser.NOTIFY_INCLUDE then
-        self:run_callback("line", "notify_include", line)
-        self:run_callback("notify_include", line, parsed[2])
-
-    elseif parsed[1] == parser.NOTIFY_NOTE then
-        self:run_callback("line", "notify_note", line)
-        self:run_callback("notify_note", line, parsed[2])
-
-    elseif parsed[1] == parser.NOTIFY_ARRIVE then
-        self:run_callback(line, "notify_arrive", line)
-        self:run_callback("notify_arrive", line, parsed[2], parsed[3])
-
-    elseif parsed[1] == parser.NOTIFY_DEPART then
-        self:run_callback(line, "notify_depart", line)
-        self:run_callback("notify_depart", line, parsed[2], parsed[3])
-
-    -- Chat (may be wrapped by server.)
-    elseif parsed[1] == parser.TELL then
-        self._last_wrapping_group = "tell"
-
-        self:run_callback("line", "tell", line)
-        self:run_callback("tell", line, parsed[2], parsed[3], parsed[4])
-
-    elseif parsed[1] == parser.CHANTELL then
-        self._last_wrapping_group = "chantell"
-
-        self:run_callback("line", "chantell", line)
-        self:run_callback("chantell", line, parsed[2], parsed[3], parsed[4],
-            parsed[5])
-
-    elseif parsed[1] == parser.QTELL then
-        self._last_wrapping_group = "qtell"
-
-        self:run_callback("line", "qtell", line)
-        self:run_callback("qtell", line, parsed[2])
-
-    elseif parsed[1] == parser.IT then
-        self._last_wrapping_group = "it"
-
-        self:run_callback("line", "it", line)
-        self:run_callback("it", line, parsed[1], parsed[2], parsed[3])
-
-    elseif parsed[1] == parser.SHOUT then
-        self._last_wrapping_group = "shout"
-
-        self:run_callback("line", "shout", line)
-        self:run_callback("shout", line, parsed[1], parsed[2], parsed[3])
-
-    elseif parsed[1] == parser.CSHOUT then
-        self._last_wrapping_group = "cshout"
-
-        self:run_callback("line", "cshout", line)
-        self:run_callback("cshout", line, parsed[1], parsed[2], parsed[3])
-
-    elseif parsed[1] == parser.ANNOUNCEMENT then
-        self._last_wrapping_group = "announcement"
-
-        self:run_callback("line", "announcement", line)
-        self:run_callback("announcement", line, parsed[1], parsed[2])
-
-    elseif parsed[1] == parser.KIBITZ then
-        self._last_wrapping_group = "kibitz"
-
-        self:run_callback("line", "kibitz", line)
-        self:run_callback("kibitz", line, parsed[1], parsed[2], parsed[3],
-            parsed[4], parsed[5])
-
-    elseif parsed[1] == parser.WHISPER then
-        self._last_wrapping_group = "whisper"
-
-        self:run_callback("line", "whisper", line)
-        self:run_callback("whisper", line, parsed[1], parsed[2], parsed[3],
-            parsed[4], parsed[5])
-
-    -- Challenge
-    elseif parsed[1] == parser.CHALLENGE_UPDATE then
-        self:run_callback("line", "challenge", line)
-        if not self.callbacks["challenge"] then return true end
-        self.__parse_chunk_game_update = true
-
-    elseif parsed[1] == parser.MATCH_REQUEST then
-        self:run_callback("line", "challenge", line)
-
-        if self.__parse_chunk_game_update then
-            parsed[2].update = true
-        else
-            parsed[2].update = false
-        end
-        self.__parse_chunk_game_update = nil
-
-        if parsed[2].rated == false then
-            -- Don't wait for the next line to call the callback
-            self:run_callback("challenge", line, parsed[3], parsed[4],
-                parsed[2])
-        else
-            self.__parse_chunk_game = parsed[2]
-            self.__parse_chunk_player1 = parsed[3]
-            self.__parse_chunk_player2 = parsed[4]
-        end
+    end
 
-    elseif parsed[1] == parser.RATING_CHANGE then
-        self:run_callback("line", "challenge", line)
-        if not self.callbacks["challenge"] then return true end
-
-        self.__parse_chunk_game.win = parsed[3]
-        self.__parse_chunk_game.draw = parsed[4]
-        self.__parse_chunk_game.loss = parsed[5]
-
-    elseif parsed[1] == parser.NEWRD then
-        self:run_callback("line", "challenge", line)
-        -- Don't return here because parse chunks must be set to nil.
-        -- if not self.callbacks["challenge"] then return true end
-
-        self.__parse_chunk_game.newrd = parsed[2]
-        self:run_callback("challenge", line, self.__parse_chunk_player1,
-            self.__parse_chunk_player2, self.__parse_chunk_game)
-        self.__parse_chunk_game = nil
-        self.__parse_chunk_player1 = nil
-        self.__parse_chunk_player2 = nil
-
-    -- Bughouse
-    elseif parsed[1] == parser.PARTNER_OFFER then
-        self:run_callback("line", "partner", line)
-        self:run_callback("partner", line, parsed[2])
-
-    -- Game start/end
-    elseif parsed[1] == parser.GAME_START then
-        self:run_callback("line", "game_start", line)
-        self:run_callback("game_start", line, parsed[2], parsed[3], parsed[4],
-            parsed[5])
-
-    elseif parsed[1] == parser.GAME_END then
-        self:run_callback("line", "game_end", line)
-        self:run_callback("game_end", line, parsed[2], parsed[3], parsed[4],
-            parsed[5], parsed[6])
-
-    -- Style 12
-    elseif parsed[1] == parser.STYLE12 then
-        self:run_callback("line", "style12", line)
-        self:run_callback("style12", line, parsed[2])
-
-    -- Offers
-    elseif parsed[1] == parser.DRAW then
-        self:run_callback("line", "offer_draw", line)
-        self:run_callback("offer_draw", line, parsed[2])
-
-    elseif parsed[1] == parser.DRAW_ACCEPT then
-        self:run_callback("line", "draw_accept", line)
-        self:run_callback("draw_accept", line, parsed[2])
-
-    elseif parsed[1] == parser.DRAW_DECLINE then
-        self:run_callback("line", "draw_decline", line)
-        self:run_callback("draw_decline", line, parsed[2])
-
-    elseif parsed[1] == parser.ABORT then
-        self:run_callback("line", "offer_abort", line)
-        self:run_callback("offer_abort", line, parsed[2])
-
-    elseif parsed[1] == parser.ABORT_ACCEPT then
-        self:run_callback("line", "abort_accept", line)
-        self:run_callback("abort_accept", line, parsed[2])
-
-    elseif parsed[1] == parser.ABORT_DECLINE then
-        self:run_callback("line", "abort_decline", line)
-        self:run_callback("abort_decline", line, parsed[2])
-
-    elseif parsed[1] == parser.ADJOURN then
-        self:run_callback("line", "offer_adjourn", line)
-        self:run_callback("offer_adjourn", line, parsed[2])
-
-    elseif parsed[1] == parser.ADJOURN_ACCEPT then
-        self:run_callback("line", "adjourn_accept", line)
-        self:run_callback("adjourn_accept", line, parsed[2])
-
-    elseif parsed[1] == parser.ADJOURN_DECLINE then
-        self:run_callback("line", "adjourn_decline", line)
-        self:run_callback("adjourn_decline", line, parsed[2])
-
-    elseif parsed[1] == parser.TAKEBACK then
-        self:run_callback("line", "offer_takeback", line)
-        self:run_callback("offer_takeback", line, parsed[2], parsed[3])
-
-    elseif parsed[1] == parser.TAKEBACK_ACCEPT then
-        self:run_callback("line", "takeback_accept", line)
-        self:run_callback("takeback_accept", line, parsed[2])
-
-    elseif parsed[1] == parser.TAKEBACK_DECLINE then
-        self:run_callback("line", "takeback_decline", line)
-        self:run_callback("takeback_decline", line, parsed[2])
-
-    -- Seeks
-    elseif parsed[1] == parser.SEEKINFO then
-        self:run_callback("line", "seek", line)
-        self:run_callback("seek", line, parsed[2])
-
-    elseif parsed[1] == parser.SEEKREMOVE then
-        self:run_callback("line", "seekremove", line)
-        self:run_callback("seekremove", line, parsed[2])
-
-    elseif parsed[1] == parser.SEEKCLEAR then
-        self:run_callback("line", "seekclear", line)
-        self:run_callback("seekclear", line)
-
-    -- Examined/Observed
-    elseif parsed[1] == parser.MOVE then
-        self:run_callback("line", "move", line)
-        self:run_callback("move", line, parsed[2], parsed[3], parsed[4])
-
-    elseif parsed[1] == parser.EXAMINING then
-        self:run_callback("line", "examining", line)
-        self:run_callback("examining", line, parsed[2])
-
-    -- Telnet
-    elseif parsed[1] == parser.IAC_WILL_ECHO  then
-        self:run_callback("line", "iacwillecho", line)
-        self:run_callback("iacwillecho", line)
-
-    elseif parsed[1] == parser.IAC_WONT_ECHO then
-        self:run_callback("line", "iacwontecho", line)
-        self:run_callback("iacwontecho", line)
-    else
+    local handler = handlers[parsed[1]]
+    if handler == nil then
         error("unhandled parser id " .. parsed[1])
     end
 
+    local status, errmsg = handler.func(self, line, parsed)
+    if status == nil and errmsg ~= nil then return nil, errmsg end
     return true
 end --}}}
 --- Enter main loop.
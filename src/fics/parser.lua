@@ -315,15 +315,18 @@ game_end = (P"{Game " * number * P" (" * handle * P" vs. " * handle * P") " *
 -- Style 12
 piece = S"rnbqkbnrpRNBQKBNRP-"
 rank = C(piece^8)
-board = ((rank * P" ")^7 * rank) / function (...)
+-- Repetition doesn't backtrack, so the separators precede the ranks.
+board = (rank * (P" " * rank)^7) / function (...)
     local board = {}
 
-    for i=8,1,-1 do
+    -- The ranks are listed from the eighth down.
+    for i=1,8 do
         local pieces = arg[i]
-        local rank = string.byte"a"
-        while rank <= string.byte"h" do
-            board[string.char(rank) .. i] = string.sub(pieces, i, i)
-            rank = rank + 1
+        local file = string.byte"a"
+        while file <= string.byte"h" do
+            local j = file - string.byte"a" + 1
+            board[string.char(file) .. (9 - i)] = string.sub(pieces, j, j)
+            file = file + 1
         end
     end
     return board
@@ -460,3 +463,35 @@ telnet = iac_will_echo + iac_wont_echo
 
 p = prompts + authentication + session_start + notification +
     chat + challenge + bughouse + game + offer + seek + exob + telnet
+
+-- Ids and patterns of p in the same order, used by clients to generate parsers
+-- which only match the lines they have callbacks for.
+patterns = {
+    {PROMPT_LOGIN, login}, {PROMPT_PASSWORD, password},
+    {PROMPT_SERVER, server_prompt},
+    {HANDLE_TOO_SHORT, handle_too_short}, {HANDLE_TOO_LONG, handle_too_long},
+    {HANDLE_NOT_ALPHA, handle_not_alpha},
+    {HANDLE_NOT_REGISTERED, handle_not_registered},
+    {HANDLE_BANNED, handle_banned}, {PASSWORD_INVALID, password_invalid},
+    {PRESS_RETURN, press_return},
+    {WELCOME, welcome}, {NEWS, news}, {MESSAGES, messages},
+    {NOTIFY_INCLUDE, notify_include}, {NOTIFY_NOTE, notify_note},
+    {NOTIFY_ARRIVE, notify_arrive}, {NOTIFY_DEPART, notify_depart},
+    {TELL, tell}, {CHANTELL, chantell}, {QTELL, qtell}, {IT, it},
+    {SHOUT, shout}, {CSHOUT, cshout}, {ANNOUNCEMENT, announcement},
+    {KIBITZ, kibitz}, {WHISPER, whisper},
+    {CHALLENGE_UPDATE, challenge_update}, {MATCH_REQUEST, match_request},
+    {RATING_CHANGE, rating_change}, {NEWRD, newrd},
+    {PARTNER_OFFER, partner_offer},
+    {GAME_END, game_end}, {GAME_START, game_start}, {STYLE12, style12},
+    {DRAW, draw}, {DRAW_ACCEPT, draw_accept}, {DRAW_DECLINE, draw_decline},
+    {ABORT, abort}, {ABORT_ACCEPT, abort_accept},
+    {ABORT_DECLINE, abort_decline},
+    {ADJOURN, adjourn}, {ADJOURN_ACCEPT, adjourn_accept},
+    {ADJOURN_DECLINE, adjourn_decline},
+    {TAKEBACK, takeback}, {TAKEBACK_ACCEPT, takeback_accept},
+    {TAKEBACK_DECLINE, takeback_decline},
+    {SEEKINFO, seekinfo}, {SEEKREMOVE, seekremove}, {SEEKCLEAR, seekclear},
+    {MOVE, move}, {EXAMINING, examining},
+    {IAC_WILL_ECHO, iac_will_echo}, {IAC_WONT_ECHO, iac_wont_echo},
+}
@@ -0,0 +1,190 @@
+#!/usr/bin/env lua
+-- vim: set ft=lua et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+--{{{ Grab environment we need
+local assert = assert
+local ipairs = ipairs
+local next = next
+local pcall = pcall
+local setmetatable = setmetatable
+local type = type
+
+local os = os
+local table = table
+require "chess.fics.utils"
+local utils = chess.fics.utils
+--}}}
+--{{{ Variables
+--- Lua module to run many chess.fics and chess.icc clients in one process.<br />
+-- The sockets of the clients are polled together and lines are parsed as they
+-- arrive, so no client blocks the others.
+module "chess.fics.reactor"
+
+--- Number of bytes read from a socket at a time.
+RECV_SIZE = 8192
+
+reactor = {}
+--}}}
+--{{{ reactor functions
+--- Create a new reactor.
+-- @param argtable A table which may have the following elements<br />
+-- <ul>
+--  <li><tt>idle_interval</tt>: Seconds between runs of the <tt>idle</tt>
+--      callbacks of the clients, defaults to <tt>1</tt>.</li>
+-- </ul>
+-- @return reactor instance
+function reactor:new(argtable) --{{{
+    local argtable = argtable or {}
+    assert(type(argtable) == "table", "argument is not a table")
+
+    local instance = {
+        idle_interval = argtable.idle_interval or 1,
+        clients = {},
+
+        -- Internal
+        _next_idle = 0,
+    }
+
+    return setmetatable(instance, { __index = reactor })
+end --}}}
+--- Add a connected client.<br />
+-- Data the client's socket has already buffered, like what came along with the
+-- login, doesn't wake poll up, so such sockets are checked with
+-- <tt>sock:dirty()</tt> and dispatched without waiting.
+-- @param client chess.fics or chess.icc client.
+-- @return <tt>nil</tt>
+function reactor:add(client) --{{{
+    assert(client.sock ~= nil, "not connected")
+
+    client.sock:settimeout(0)
+    table.insert(self.clients, client)
+end --}}}
+--- Remove a client, the client isn't disconnected.
+-- @param client chess.fics or chess.icc client.
+-- @return <tt>true</tt> if the client was found and removed, <tt>false</tt>
+-- otherwise.
+function reactor:remove(client) --{{{
+    for index, c in ipairs(self.clients) do
+        if c == client then
+            table.remove(self.clients, index)
+            return true
+        end
+    end
+    return false
+end --}}}
+-- Read from the socket of a client and parse the complete lines.
+local function dispatch(client) --{{{
+    local data, errmsg, partial = client.sock:receive(RECV_SIZE)
+    data = data or partial
+    if data ~= nil and data ~= "" then client:feed(data) end
+
+    while true do
+        local line, internal = client:nextline()
+        if line ~= nil then
+            local status, perrmsg = client:parseline(line)
+            if status == nil then return nil, perrmsg end
+        elseif internal == nil then
+            break
+        end
+    end
+
+    if errmsg ~= nil and errmsg ~= "timeout" then return nil, errmsg end
+    return true
+end --}}}
+-- Remove a failed client, disconnect it and run its disconnect callbacks.
+-- Errors of the callbacks are ignored, they can't fail the client again.
+local function fail(reactor, client, errmsg) --{{{
+    reactor:remove(client)
+    if client.sock ~= nil then client:disconnect() end
+    pcall(client.run_callback, client, "disconnect", errmsg)
+end --}}}
+--- Wait for data from the clients and parse it.<br />
+-- The <tt>idle</tt> callbacks of the clients are run every
+-- <tt>idle_interval</tt> seconds. Clients which fail, or whose callbacks
+-- raise an error, are removed and disconnected, their <tt>disconnect</tt>
+-- callbacks are run with the error message.
+-- @param timeout Seconds to wait at most, waits until the next run of the
+-- <tt>idle</tt> callbacks if nil.
+-- @return <tt>true</tt> on success, <tt>nil</tt> and error message on failure.
+function reactor:step(timeout) --{{{
+    -- Clients disconnected outside the reactor are dropped.
+    for index = #self.clients, 1, -1 do
+        if self.clients[index].sock == nil then table.remove(self.clients, index) end
+    end
+
+    local now = os.time()
+    if now >= self._next_idle then
+        -- Failed clients are removed meanwhile.
+        local clients = {}
+        for index, client in ipairs(self.clients) do clients[index] = client end
+        for _, client in ipairs(clients) do
+            local status, errmsg = pcall(client.run_callback, client, "idle",
+                now - client._last_sent)
+            if not status then fail(self, client, errmsg) end
+        end
+        self._next_idle = now + self.idle_interval
+    end
+
+    local wait = self._next_idle - now
+    if timeout == nil or timeout > wait then timeout = wait end
+
+    -- Sockets with buffered data are read without waiting.
+    local clients, fds, pending = {}, {}, {}
+    for index, client in ipairs(self.clients) do
+        clients[index] = client
+        fds[index] = client.sock:getfd()
+        if client.sock:dirty() then pending[index] = true end
+    end
+    if next(pending) ~= nil then timeout = 0 end
+
+    local ready, errmsg = utils.poll(fds, timeout)
+    if ready == nil then return nil, errmsg end
+    for _, index in ipairs(ready) do pending[index] = true end
+
+    for index = 1, #clients do
+        local client = clients[index]
+        -- Callbacks may have disconnected the client meanwhile.
+        if pending[index] and client.sock ~= nil then
+            local status, ok, errmsg = pcall(dispatch, client)
+            if not status then
+                fail(self, client, ok)
+            elseif ok == nil then
+                fail(self, client, errmsg)
+            end
+        end
+    end
+
+    return true
+end --}}}
+--- Enter main loop.
+-- @param times How many times to loop, if 0 loop until no client is left.
+-- Defaults to <tt>0</tt>.
+-- @return <tt>true</tt> on success, <tt>nil</tt> and error message on failure.
+function reactor:loop(times) --{{{
+    local times = times or 0
+
+    local count = 0
+    while #self.clients > 0 and (times <= 0 or count < times) do
+        local status, errmsg = self:step()
+        if status == nil then return nil, errmsg end
+        count = count + 1
+    end
+
+    return true
+end --}}}
+--}}}
@@ -24,6 +24,7 @@
 
 #include "config.h"
 
+#include <ctype.h> /* isdigit() */
 #include <errno.h>
 #include <string.h> /* strerror() */
 
@@ -36,6 +37,7 @@
 #include <sys/utsname.h> /* uname() */
 
 #ifndef WIN32
+#include <poll.h> /* poll() */
 #include <pwd.h> /*  getpwuid() */
 #else
 /* Grabbed from git */
@@ -76,6 +78,7 @@ char *strlasterror(void) {
 /* Encryption strings used by FICS */
 #define TIMESEAL_MAGICGSTR "^%[G%]"
 #define TIMESEAL_GRESPONSE "\0029"
+#define TIMESEAL_MAGICG "[G]"
 
 #define ENCODESTR "Timestamp (FICS) v1.0 - programmed by Henrik Gram."
 #define ENCODELEN 50
@@ -297,7 +300,139 @@ static int titles_totable(lua_State *L) {
     return 1;
 }
 
+/* Returns the length of the prompt p starts with, 0 if there's none.
+ * Prompts aren't terminated by a newline, keep in sync with parser.prompts
+ */
+static size_t prompt_len(const char *p, size_t len) {
+    size_t i, j, k;
+
+    if (len >= 7 && 0 == memcmp(p, "login: ", 7))
+        return 7;
+    if (len >= 10 && 0 == memcmp(p, "password: ", 10))
+        return 10;
+
+    /* Server prompt with optional timestamp like 12:34_fics% */
+    i = 0;
+    for (;;) {
+        for (j = i; j < len && j - i < 2 && isdigit((unsigned char)p[j]); j++)
+            ;
+        if (j == len || ':' != p[j])
+            break;
+        for (k = ++j; j < len && j - k < 2 && isdigit((unsigned char)p[j]); j++)
+            ;
+        i = j;
+    }
+    while (i < len && '_' == p[i])
+        i++;
+    if (len - i >= 6 && 0 == memcmp(p + i, "fics% ", 6))
+        return i + 6;
+    return 0;
+}
+
+static int split_lines(lua_State *L) {
+    size_t len, i, run, start, plen;
+    int timeseal, n, table;
+    const char *p;
+    luaL_Buffer buf;
+
+    p = luaL_checklstring(L, 1, &len);
+    timeseal = lua_toboolean(L, 2);
+
+    lua_newtable(L);
+    table = lua_gettop(L);
+    n = 0;
+    start = 0;
+    luaL_buffinit(L, &buf);
+    for (i = 0; i < len; ) {
+        if (start == i) {
+            /* Start of a line, carriage returns are dropped. */
+            while (i < len && '\r' == p[i])
+                start = ++i;
+            plen = prompt_len(p + i, len - i);
+            if (plen > 0) {
+                luaL_addlstring(&buf, p + i, plen);
+                luaL_pushresult(&buf);
+                lua_rawseti(L, table, ++n);
+                luaL_buffinit(L, &buf);
+                start = i += plen;
+                continue;
+            }
+        }
+
+        for (run = i; run < len && '\r' != p[run] && '\n' != p[run]; run++)
+            ;
+        luaL_addlstring(&buf, p + i, run - i);
+        i = run;
+        if (i == len)
+            break;
+        else if ('\r' == p[i++])
+            continue;
+
+        luaL_pushresult(&buf);
+        if (timeseal && 0 == strncmp(p + start, TIMESEAL_MAGICG, strlen(TIMESEAL_MAGICG))) {
+            lua_pop(L, 1);
+            lua_pushboolean(L, 0);
+        }
+        lua_rawseti(L, table, ++n);
+        luaL_buffinit(L, &buf);
+        start = i;
+    }
+    luaL_pushresult(&buf);
+    lua_pop(L, 1);
+
+    lua_pushlstring(L, p + start, len - start);
+    return 2;
+}
+
+static int poll_fds(lua_State *L) {
+#ifndef WIN32
+    int i, n, nready, timeout;
+    struct pollfd *fds;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    n = lua_objlen(L, 1);
+    /* Negative timeouts block until a descriptor is ready. */
+    timeout = lua_isnoneornil(L, 2) ? -1 : (int)(luaL_checknumber(L, 2) * 1000);
+    if (timeout < -1)
+        timeout = -1;
+
+    fds = (struct pollfd *) lua_newuserdata(L, (n > 0 ? n : 1) * sizeof(struct pollfd));
+    for (i = 0; i < n; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        fds[i].fd = lua_tointeger(L, -1);
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+        lua_pop(L, 1);
+    }
+
+    nready = poll(fds, n, timeout);
+    if (nready == -1 && errno != EINTR) {
+        /* Push nil and error message */
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+
+    /* Closed and failed descriptors are readable, reading reports the error. */
+    lua_newtable(L);
+    for (i = 0, nready = 0; i < n; i++) {
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) {
+            lua_pushinteger(L, i + 1);
+            lua_rawseti(L, -2, ++nready);
+        }
+    }
+    return 1;
+#else
+    /* Push nil and error message */
+    lua_pushnil(L);
+    lua_pushliteral(L, "poll not supported");
+    return 2;
+#endif
+}
+
 static const luaL_reg ficsutils_global[] = {
+    {"poll",                     poll_fds},
+    {"split_lines",              split_lines},
     {"timeseal_encode",          timeseal_encode},
     {"timeseal_init_string",     timeseal_init_string},
     {"titles_totable",           titles_totable},
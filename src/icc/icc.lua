@@ -28,7 +28,9 @@ local unpack = unpack
 local os = os
 local string = string
 local socket = require "socket"
+require "chess.icc.utils"
 require "chess.icc.parser"
+local utils = chess.icc.utils
 local parser = chess.icc.parser
 --}}}
 --{{{ Variables
@@ -46,6 +48,8 @@ LF = "\n"
 RCTE = string.char(7)
 EOR = string.char(25)
 --}}}
+--- Number of bytes read from the socket at a time.
+RECV_SIZE = 8192
 --{{{ ICC level 2 codes
 DG_WHO_AM_I = 0
 DG_PLAYER_ARRIVED = 1
@@ -249,7 +253,9 @@ function client:new(argtable) --{{{
         _last_sent = 0,
         _settings_sent = false,
         _linebuf = "",
-        _in_datagram = false,
+        _lines = {},
+        _lines_first = 1,
+        _lines_last = 0,
     }
 
     local ci = setmetatable(instance, { __index = client })
@@ -552,7 +558,9 @@ function client:disconnect() --{{{
     self._last_sent = 0
     self._settings_sent = false
     self._linebuf = ""
-    self._in_datagram = false
+    self._lines = {}
+    self._lines_first = 1
+    self._lines_last = 0
 end --}}}
 --- Send data to the server.
 -- @param data Data to send
@@ -572,7 +580,25 @@ function client:send(data) --{{{
 
     return bytes, errmsg
 end --}}}
+--- Split data received from the server into lines and datagrams.<br />
+-- Complete ones are queued for <tt>recvline</tt>, the rest is kept until more
+-- data arrives. Nested datagrams are kept in the datagram around them.
+-- @param data Data received from the server.
+-- @return <tt>nil</tt>
+function client:feed(data) --{{{
+    local lines, rest = utils.datagrams(self._linebuf .. data)
+    local queue, last = self._lines, self._lines_last
+
+    for i=1,#lines do
+        queue[last + i] = lines[i]
+    end
+
+    self._lines_last = last + #lines
+    self._linebuf = rest
+end --}}}
 --- Receive a line from the server.
+-- Reads up to <tt>RECV_SIZE</tt> bytes at a time when no complete line is
+-- queued.
 -- @return The received line, <tt>nil</tt> and error message on failure.
 -- <br/><b>Note:</b><br />
 -- The error message may be <tt>internal</tt> for internal lines like timeseal
@@ -581,41 +607,32 @@ function client:recvline() --{{{
     assert(self.sock ~= nil, "not connected")
 
     self:run_callback("idle", os.time() - self._last_sent)
-    while true do
-        local chunk, errmsg = self.sock:receive(1)
-        if chunk == nil then
+    while self._lines_first > self._lines_last do
+        local data, errmsg, partial = self.sock:receive(RECV_SIZE)
+        data = data or partial
+        if data ~= nil and data ~= "" then self:feed(data) end
+        if errmsg ~= nil and self._lines_first > self._lines_last then
             return nil, errmsg
         end
-
-        if chunk == EOR then
-            -- Receive another byte
-            local chunk, errmsg = self.sock:receive(1)
-            if chunk == nil then
-                return nil, errmsg
-            end
-
-            self._linebuf = self._linebuf .. EOR .. chunk
-            if chunk == "(" then
-                self._in_datagram = true
-            elseif chunk == ")" then
-                self._in_datagram = false
-                break
-            end
-        elseif chunk == CR then
-            if not self._in_datagram then break end
-        elseif chunk ~= LF then
-            self._linebuf = self._linebuf .. chunk
-
-            if parser.prompts:match(self._linebuf) then
-                break
-            end
-        elseif chunk == RCTE then
-            break
-        end
     end
 
-    local line = self._linebuf
-    self._linebuf = ""
+    return self:nextline()
+end --}}}
+--- Take the next line queued by <tt>feed</tt>.
+-- @return The line, <tt>nil</tt> if no line is queued.
+-- <br/><b>Note:</b><br />
+-- <tt>nil</tt> and <tt>internal</tt> are returned for internal lines.
+function client:nextline() --{{{
+    local first = self._lines_first
+    if first > self._lines_last then return nil end
+
+    local line = self._lines[first]
+    self._lines[first] = nil
+    if first == self._lines_last then
+        self._lines_first, self._lines_last = 1, 0
+    else
+        self._lines_first = first + 1
+    end
 
     line = parser.suppress_prompt:match(line)
     if line then return line
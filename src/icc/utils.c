@@ -0,0 +1,137 @@
+/* ICC utilities for LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+
+LUALIB_API int luaopen_chess_icc_utils(lua_State *L);
+
+#define CR '\r'
+#define LF '\n'
+#define EOR '\031'
+
+/* Prompts aren't terminated by a newline, keep in sync with parser.prompts */
+static const char *prompts[] = {"login: ", "password: ", NULL};
+
+/* Returns the length of the prompt p starts with, 0 if there's none. */
+static size_t prompt_len(const char *p, size_t len) {
+    int i;
+    size_t plen;
+
+    for (i = 0; prompts[i] != NULL; i++) {
+        plen = strlen(prompts[i]);
+        if (plen <= len && 0 == memcmp(p, prompts[i], plen))
+            return plen;
+    }
+    return 0;
+}
+
+/* Splits data into lines and level 2 datagrams.
+ * Returns an array of the complete ones and the rest of the data, which
+ * should be prepended to the data received next.
+ */
+static int datagrams(lua_State *L) {
+    size_t len, i, run, start, plen;
+    int depth, n, table;
+    const char *p;
+    luaL_Buffer buf;
+
+    p = luaL_checklstring(L, 1, &len);
+
+    lua_newtable(L);
+    table = lua_gettop(L);
+    n = 0;
+    depth = 0;
+    start = 0;
+    luaL_buffinit(L, &buf);
+    for (i = 0; i < len; ) {
+        if (0 == depth && start == i) {
+            /* Start of a line, linefeeds are dropped. */
+            while (i < len && LF == p[i])
+                start = ++i;
+            plen = prompt_len(p + i, len - i);
+            if (plen > 0) {
+                luaL_addlstring(&buf, p + i, plen);
+                luaL_pushresult(&buf);
+                lua_rawseti(L, table, ++n);
+                luaL_buffinit(L, &buf);
+                start = i += plen;
+                continue;
+            }
+            if (i == len)
+                break;
+        }
+
+        for (run = i; run < len && EOR != p[run] && CR != p[run] && LF != p[run]; run++)
+            ;
+        if (run > i) {
+            luaL_addlstring(&buf, p + i, run - i);
+            i = run;
+            continue;
+        }
+
+        if (EOR == p[i]) {
+            /* Datagram delimiters are two bytes, wait for the second one. */
+            if (i + 1 == len)
+                break;
+            luaL_addlstring(&buf, p + i, 2);
+            i += 2;
+            if ('(' == p[i - 1])
+                ++depth;
+            else if (')' == p[i - 1] && depth <= 1) {
+                depth = 0;
+                luaL_pushresult(&buf);
+                lua_rawseti(L, table, ++n);
+                luaL_buffinit(L, &buf);
+                start = i;
+            }
+            else if (')' == p[i - 1])
+                --depth;
+        }
+        else if (CR == p[i]) {
+            /* Carriage returns end lines but not datagrams. */
+            ++i;
+            if (0 == depth) {
+                luaL_pushresult(&buf);
+                lua_rawseti(L, table, ++n);
+                luaL_buffinit(L, &buf);
+                start = i;
+            }
+        }
+        else
+            ++i;
+    }
+    luaL_pushresult(&buf);
+    lua_pop(L, 1);
+
+    lua_pushlstring(L, p + start, len - start);
+    return 2;
+}
+
+static const luaL_reg iccutils_global[] = {
+    {"datagrams",       datagrams},
+    {NULL,              NULL}
+};
+
+LUALIB_API int luaopen_chess_icc_utils(lua_State *L) {
+    luaL_register(L, "chess.icc.utils", iccutils_global);
+    return 1;
+}
@@ -25,6 +25,7 @@ require "customloaders"
 require "bit"
 require "chess.bitboard"
 require "chess.attack"
+require "chess"
 
 local bb = chess.bitboard.bb
 
@@ -171,6 +172,179 @@ TestAttack = {} -- class
     end
     function TestAttack:test_07_atak_queen_TODO()
     end
+    function TestAttack:test_08_attackers_to()
+        local board = chess.Board{}
+        board:loadfen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1")
+        local sq = chess.squarei
+        -- f7 is attacked by the knight on e5 and defended by the king and queen.
+        local white = chess.attack.attackers_to(board, sq"f7", WHITE)
+        assert(white:popcount() == 1)
+        assert(white:tstbit(sq"e5"))
+        local black = chess.attack.attackers_to(board.core, sq"f7", BLACK)
+        assert(black:popcount() == 2)
+        assert(black:tstbit(sq"e8") and black:tstbit(sq"e7"))
+        assert(board:attackers_to(sq"f7") == white + black)
+        assert(not pcall(chess.attack.attackers_to, board, 64, WHITE))
+    end
+    function TestAttack:test_09_attacked_by()
+        local board = chess.Board{}
+        board:loadfen()
+        local attacked = chess.attack.attacked_by(board, WHITE)
+        -- Every square on the second and third ranks, and b1 to g1.
+        assert(attacked == bb("ffff7e"))
+        assert(not board:is_in_check())
+        assert(board:can_castle(true) == false)
+
+        board:loadfen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1")
+        assert(board:can_castle(true) and board:can_castle(false))
+        board:loadfen("r3k2r/8/8/8/8/8/8/R3K1rR w KQkq - 0 1")
+        assert(board:is_in_check())
+        assert(not board:can_castle(false))
+        board:loadfen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1")
+        board:set_piece(chess.squarei"d8", QUEEN, BLACK)
+        assert(board:can_castle(true) and not board:can_castle(false))
+    end
+    function TestAttack:test_10_see()
+        local board = chess.Board{}
+        local sq = chess.squarei
+        local see = chess.attack.see
+        local function mv(f, t)
+            local move = chess.MOVE(sq(f), sq(t))
+            local piece = board:get_piece(sq(t))
+            if piece then move = move + piece * 2^15 end
+            return move
+        end
+
+        -- Undefended pawn
+        board:loadfen("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1")
+        assertEquals(see(board, mv("e1", "e5")), 100)
+        -- Knight takes a pawn defended by a knight and a bishop x-rayed by the queen.
+        board:loadfen("1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1")
+        assertEquals(see(board, mv("d3", "e5")), -225)
+        -- The rook behind the capturing rook is counted.
+        board:loadfen("6k1/4r3/8/4p3/8/8/4R3/4R1K1 w - - 0 1")
+        assertEquals(see(board, mv("e2", "e5")), 100)
+        -- Quiet move to a square attacked by a pawn.
+        board:loadfen("4k3/8/3p4/8/8/8/8/2Q1K3 w - - 0 1")
+        assertEquals(see(board.core, mv("c1", "c5")), -975)
+        -- The king can't take a defended piece.
+        board:loadfen("4k3/3r4/8/8/8/8/3P4/4K3 b - - 0 1")
+        assertEquals(board:see(mv("d7", "d2")), -400)
+        board:loadfen("3qk3/3r4/8/8/8/8/3P4/4K3 b - - 0 1")
+        assertEquals(board:see(mv("d7", "d2")), 100)
+        assert(not pcall(see, board, mv("a3", "a4")))
+
+        -- Every queen line and knight jump to d4 is taken by an attacker.
+        board:clear_all()
+        local d4, n = sq"d4", 0
+        board:set_piece(d4, PAWN, BLACK)
+        for s=0,63 do
+            local df, dr = math.abs(s % 8 - 3), math.abs(math.floor(s / 8) - 3)
+            if s ~= d4 then
+                local piece
+                if df == 0 or dr == 0 or df == dr then piece = QUEEN
+                elseif df + dr == 3 and df ~= 0 and dr ~= 0 then piece = KNIGHT end
+                if piece then
+                    n = n + 1
+                    board:set_piece(s, piece, n % 2 == 0 and WHITE or BLACK)
+                end
+            end
+        end
+        -- The swap list is longer than the 32 pieces of a legal position, the
+        -- queen taking the pawn is lost to a knight.
+        assert(n == 35)
+        assertEquals(see(board, mv("c3", "d4")), -875)
+    end
+    function TestAttack:test_11_magic_layout()
+        local layouts = {minimized = true, plain = true, perfect = true, pext = true}
+        assert(layouts[chess.attack._MAGIC])
+        assert(chess.attack._MAGIC == chess.board._MAGIC)
+        assert(chess.attack._MAGIC_SIZE > 0)
+
+        -- Compare the slider lookups with walking the rays.
+        local function walk(sq, occ, dirs)
+            local ret = bb(0)
+            for _, d in ipairs(dirs) do
+                local f, r = sq % 8 + d[1], math.floor(sq / 8) + d[2]
+                while f >= 0 and f < 8 and r >= 0 and r < 8 do
+                    ret:setbit(r * 8 + f)
+                    if occ:tstbit(r * 8 + f) then break end
+                    f, r = f + d[1], r + d[2]
+                end
+            end
+            return ret
+        end
+        local diagonal = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}}
+        local straight = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}}
+        local seed = 12345
+        for i=1,8 do
+            local occ = bb(0)
+            for j=1,12 do
+                seed = (seed * 1103515245 + 12345) % 2147483648
+                occ:setbit(seed % 64)
+            end
+            for sq=0,63 do
+                assert(chess.attack.atak(BISHOP, sq, nil, occ) == walk(sq, occ, diagonal))
+                assert(chess.attack.atak(ROOK, sq, nil, occ) == walk(sq, occ, straight))
+            end
+        end
+    end
+    function TestAttack:test_12_reopen()
+        -- The tables are built once per process, reopening doesn't rebuild
+        -- them.
+        local first = chess.attack
+        assert(first._INITS == 1)
+        for i=1,100 do
+            package.loaded["chess.attack"] = nil
+            require "chess.attack"
+        end
+        assert(chess.attack._INITS == 1)
+        assert(rawequal(chess.attack, first))
+        assert(chess.attack.atak(ROOK, 0, nil, bb(0)) == bb("1010101010101fe"))
+
+        -- The board module shares them.
+        require "chess.board"
+        assert(chess.board._INITS == 1)
+        assert(chess.board._TABLES == chess.attack._TABLES)
+    end
+    function TestAttack:test_13_geometry()
+        local A = chess.attack
+        local sq = chess.squarei
+        assert(A.between(sq"a1", sq"h8") == bb("40201008040200"))
+        assert(A.between(sq"a1", sq"a4") == bb("10100"))
+        assert(A.between(sq"a1", sq"b3") == bb(0))
+        assert(A.between(sq"e4", sq"e5") == bb(0))
+        assert(A.line(sq"c3", sq"e5") == bb("8040201008040201"))
+        assert(A.line(sq"b1", sq"b7") == bb("202020202020202"))
+        assert(A.line(sq"a1", sq"b3") == bb(0))
+        assert(A.ray(sq"d4", A.NORTH) == bb("808080800000000"))
+        assert(A.ray(sq"d4", A.SOUTHWEST) == bb("40201"))
+        assert(A.ray(sq"h4", A.EAST) == bb(0))
+        assert(A.distance(sq"a1", sq"h8") == 7)
+        assert(A.distance(sq"e4", sq"f6") == 2)
+        assert(A.manhattan(sq"a1", sq"h8") == 14)
+        assert(A.manhattan(sq"e4", sq"f6") == 3)
+        assert(A.rank_mask(sq"c2") == bb("ff00"))
+        assert(A.file_mask(sq"c2") == bb("404040404040404"))
+        assert(A.diagonal_mask(sq"b1") == bb("80402010080402"))
+        assert(A.antidiagonal_mask(sq"b1") == bb("102"))
+        assert(not pcall(A.between, 0, 64))
+        assert(not pcall(A.ray, 0, 8))
+
+        -- Every aligned pair: the line is the union of the opposite rays.
+        for a=0,63 do
+            for d=0,7 do
+                local r = A.ray(a, d)
+                for b in r:squares() do
+                    local o = (d + 4) % 8
+                    assert(A.line(a, b) == r + A.ray(a, o) + bb(1) * a)
+                    assert(A.between(a, b) == A.between(b, a))
+                    -- between is the part of the ray from b back to a
+                    assert(A.between(a, b) == r - A.ray(b, o))
+                end
+            end
+        end
+    end
 -- class
 
 ret = LuaUnit:run()
@@ -0,0 +1,175 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Unit tests for chess.pool and chess.batch
+-- Requires luaunit.
+
+require "luaunit"
+require "customloaders"
+
+require "chess"
+require "chess.pgn"
+require "chess.pool"
+require "chess.batch"
+
+local batch = chess.batch
+local pgn = chess.pgn
+local pool = chess.pool
+
+-- The workers need the same loaders as the tests.
+local prelude = 'require "customloaders"'
+
+local games = {
+    '[Event "Short"]\n[Result "1-0"]\n\n1. e4 e5 2. Bc4 Nc6 3. Qh5 Nf6 4. Qxf7# 1-0\n',
+    '[Event "Long"]\n[Result "*"]\n\n1. d4 d5 2. c4 e6 3. Nc3 Nf6\n4. Bg5 Be7 *\n',
+    '[Event "Comment"]\n[Result "0-1"]\n\n{A [bracket]} 1. f3 e5 2. g4 Qh4# 0-1\n',
+}
+
+-- Writes text to a temporary file and returns its name.
+local function tmpfile(text)
+    local name = os.tmpname()
+    local file = assert(io.open(name, "wb"))
+    file:write(text)
+    file:close()
+    return name
+end
+
+-- Counts the games and plies of the PGN in a source.
+local count_mapper = [[
+require "chess.pgn"
+return function (source)
+    local games, plies = 0, 0
+    for game in chess.pgn.games(source) do
+        games = games + 1
+        plies = plies + #game.moves
+    end
+    return {games = games, plies = plies}
+end
+]]
+
+local function count_reducer(acc, result)
+    acc.games = acc.games + result.games
+    acc.plies = acc.plies + result.plies
+    return acc
+end
+
+TestBatch = {} -- class
+    function TestBatch:test_01_pool_run()
+        local results = pool.run("return function (a, b) return {sum = a + b, s = a .. b} end",
+            {{1, 2}, {3, 4}, {5, 6}}, 2)
+        assert(#results == 3)
+        assert(results[2].sum == 7 and results[2].s == "34")
+        assert(results[3].sum == 11)
+
+        local ok, err = pcall(pool.run, "return function (a) error('bad ' .. a, 0) end",
+            {{"task"}}, 2)
+        assert(not ok and err == "bad task", err)
+        assert(not pcall(pool.run, "return 1", {{}}))
+        assert(not pcall(pool.run, "return function () return print end", {{}}))
+        assert(not pcall(pool.run, "return function () end", {1}))
+        ok, err = pcall(pool.run, "return function () end", {{1}, {print}}, 1)
+        assert(not ok and err == "task 2 can't be copied", err)
+
+        -- Results land under the index of their task whichever worker ran it,
+        -- tasks without a result leave a hole.
+        local tasks = {}
+        for i=1,200 do tasks[i] = {i} end
+        results = pool.run("return function (i) if i % 7 ~= 0 then return i * i end end",
+            tasks, 4)
+        for i=1,200 do
+            if i % 7 == 0 then assert(results[i] == nil, i)
+            else assert(results[i] == i * i, i) end
+        end
+
+        -- Nested tables need more stack than a C function starts with.
+        local nest = "return function (n) local t = {} for i=1,n do t = {[{}] = t} end return t end"
+        results = pool.run(nest, {{30}}, 1)
+        local depth, t = 0, results[1]
+        while next(t) do depth, t = depth + 1, select(2, next(t)) end
+        assert(depth == 30, depth)
+        assert(not pcall(pool.run, nest, {{40}}, 1))
+    end
+    function TestBatch:test_02_split()
+        local text = ""
+        for i=1,30 do text = text .. games[(i - 1) % #games + 1] .. "\n" end
+        local name = tmpfile(text)
+        local ranges = batch.split(name, "pgn", 7)
+        os.remove(name)
+        assert(#ranges > 1 and #ranges <= 7)
+        assert(ranges[1][1] == 0)
+        assert(ranges[#ranges][2] == #text)
+        for i, r in ipairs(ranges) do
+            assert(text:sub(r[1] + 1, r[1] + 1) == "[", i)
+            if i > 1 then assert(r[1] == ranges[i - 1][2]) end
+        end
+    end
+    function TestBatch:test_03_run_pgn()
+        local text = ""
+        for i=1,100 do text = text .. games[(i - 1) % #games + 1] .. "\n" end
+        local name = tmpfile(text)
+
+        local expected = {games = 0, plies = 0}
+        local file = assert(io.open(name, "rb"))
+        for game in pgn.games(file) do
+            expected.games = expected.games + 1
+            expected.plies = expected.plies + #game.moves
+        end
+        file:close()
+
+        for workers=1,4 do
+            local result = batch.run(name, {mapper = count_mapper,
+                reducer = count_reducer, init = {games = 0, plies = 0},
+                workers = workers, pieces = 9, prelude = prelude})
+            assert(result.games == expected.games, workers)
+            assert(result.plies == expected.plies, workers)
+        end
+        os.remove(name)
+        assert(expected.games == 100)
+    end
+    function TestBatch:test_04_run_epd()
+        local text = ""
+        for i=1,40 do
+            text = text .. "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - id \"start\";\n" ..
+                "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - id \"kiwipete\";\n"
+        end
+        local name = tmpfile(text)
+        local result = batch.run(name, {format = "epd", workers = 3, pieces = 5,
+            prelude = prelude, init = 0,
+            reducer = function (acc, n) return acc + n end,
+            mapper = [[
+require "chess"
+local batch = require "chess.batch"
+return function (source)
+    local board, n = chess.Board{}, 0
+    for line in batch.lines(source) do
+        local fen = line:match("^(%S+ %S+ %S+ %S+)")
+        if fen then
+            board:loadfen(fen .. " 0 1")
+            n = n + #board:legal_moves()
+        end
+    end
+    return n
+end
+]]})
+        os.remove(name)
+        assert(result == 40 * (20 + 48), result)
+    end
+-- class
+
+ret = LuaUnit:run()
+if ret > 0 then os.exit(1) end
@@ -28,6 +28,108 @@ local bb = chess.bitboard.bb
 TestBitboard = {} -- class
     function TestBitboard:test_bitboard_TODO()
     end
+    function TestBitboard:test_popcount()
+        assert(bb(0):popcount() == 0)
+        assert(bb(1):popcount() == 1)
+        assert(bb("ffffffffffffffff"):popcount() == 64)
+        assert(bb("8000000000000101"):popcount() == 3)
+    end
+    function TestBitboard:test_scan()
+        local b = bb("8000000000000110")
+        assert(b:lsb() == 4)
+        assert(b:msb() == 63)
+        assert(b:leadz() == 0)
+        assert(b:trailz() == 59)
+        assert(bb(0):lsb() == nil)
+        assert(bb(0):msb() == nil)
+
+        local squares = {}
+        while true do
+            local sq = b:poplsb()
+            if not sq then break end
+            table.insert(squares, sq)
+        end
+        assert(#squares == 3)
+        assert(squares[1] == 4 and squares[2] == 8 and squares[3] == 63)
+        assert(b == bb(0))
+    end
+    function TestBitboard:test_squares()
+        local squares = {}
+        for sq in bb("8000000000000110"):squares() do
+            table.insert(squares, sq)
+        end
+        assert(#squares == 3)
+        assert(squares[1] == 4 and squares[2] == 8 and squares[3] == 63)
+        for sq in bb(0):squares() do assert(false) end
+
+        local next, b, start = bb("ff"):squares()
+        assert(next(b, start) == 0)
+        assert(next(b, 62) == nil)
+        assert(not pcall(next, b, -2))
+        assert(not pcall(next, {}, -1))
+    end
+    function TestBitboard:test_inplace()
+        local b = bb(0)
+        local same = b:set(bb("f0")):ior(bb("0f")):iand(bb("3c")):ixor(bb("04"))
+        assert(rawequal(same, b))
+        assert(b == bb("38"))
+        b:iandnot(bb("08"))
+        assert(b == bb("30"))
+        b:ishl(4)
+        assert(b == bb("300"))
+        b:ishr(8)
+        assert(b == bb("3"))
+        b:ishl(64)
+        assert(b == bb(0))
+        b:inot()
+        assert(b == bb("ffffffffffffffff"))
+        b:set(5)
+        assert(b == bb(5))
+        assert(not pcall(b.set, b, -1))
+        assert(not pcall(b.set, b, 2^64))
+        assert(b == bb(5))
+    end
+    function TestBitboard:test_fused()
+        local out = bb(0)
+        assert(rawequal(chess.bitboard.and_not(bb("ff"), bb("0f"), out), out))
+        assert(out == bb("f0"))
+        assert(chess.bitboard.and_not(bb("ff"), bb("0f")) == bb("f0"))
+        chess.bitboard.or_and(bb("f0"), bb("0f"), bb("3c"), out)
+        assert(out == bb("3c"))
+        chess.bitboard.and_and(bb("f0"), bb("3f"), bb("1c"), out)
+        assert(out == bb("10"))
+    end
+    function TestBitboard:test_array()
+        local array = chess.bitboard.array
+        assert(not pcall(array, 0))
+        local a, b = array(13), array(13)
+        assert(#a == 13)
+        assert(a:get(1) == bb(0))
+        assert(not pcall(a.get, a, 14))
+        assert(not pcall(a.ior, a, array(12)))
+
+        for i=1,13 do
+            a:set(i, bb(2^(i - 1)))
+            b:set(i, i)
+        end
+        assert(a:popcount() == 13)
+        assert(a:union() == bb("1fff"))
+
+        local c = a:copy():ior(b)
+        local out = bb(0)
+        for i=1,13 do
+            assert(c:get(i, out) == bb(2^(i - 1) + 0) + bb(i))
+        end
+        c:iand(b)
+        for i=1,13 do assert(c:get(i) == bb(i)) end
+        c:ixor(b)
+        assert(c:popcount() == 0)
+        c:fill(bb("ffffffffffffffff"))
+        assert(c:popcount() == 13 * 64)
+        assert(not pcall(c.fill, c, -1))
+        assert(not pcall(c.set, c, 1, -1))
+        assert(c:popcount() == 13 * 64)
+    end
 -- class
 
 ret = LuaUnit:run()
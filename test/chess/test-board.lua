@@ -0,0 +1,355 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Unit tests for the board module.
+-- Requires luaunit.
+
+require "luaunit"
+require "customloaders"
+
+require "bit"
+require "chess"
+
+local bor = bit.bor
+
+local bb = chess.bitboard.bb
+
+local WHITE = chess.WHITE
+local BLACK = chess.BLACK
+
+local PAWN = chess.PAWN
+local ROOK = chess.ROOK
+local KING = chess.KING
+
+local NULLMOVE = chess.NULLMOVE
+local CASTLING = chess.CASTLING
+
+local squarei = chess.squarei
+
+local function perft(board, depth)
+    local moves = board:legal_moves()
+    if depth == 1 then return #moves end
+    local nodes = 0
+    for _, m in ipairs(moves) do
+        board:make_move(m)
+        nodes = nodes + perft(board, depth - 1)
+        board:unmake_move()
+    end
+    return nodes
+end
+
+TestBoard = {} -- class
+    function TestBoard:test_01_new()
+        local core = chess.board.new()
+        assert(core.side == WHITE)
+        assert(core.ep == -1)
+        assert(core.flag == 0)
+        assert(core.rhmc == 0)
+        assert(core.fmc == 1)
+        assert(core.li_king == squarei"e1")
+        assert(core.li_rook[1] == squarei"h1")
+        assert(core.li_rook[2] == squarei"a1")
+        for i=1,4 do assert(core:occupied(i) == bb(0), i) end
+        assert(not pcall(function () core.foo = 1 end))
+        assert(not pcall(function () core.side = 3 end))
+        assert(not pcall(core.occupied, core, 5))
+        -- Values the undo records can't hold are rejected.
+        for _, v in ipairs{-1, 0x1000000, 1e9} do
+            assert(not pcall(function () core.rhmc = v end), v)
+        end
+        assert(not pcall(function () core.flag = 0x3F end))
+        assert(not pcall(function () core.flag = -1 end))
+        assert(core.rhmc == 0 and core.flag == 0)
+
+        -- The largest ones survive a move and its unmaking.
+        core:loadfen("4k3/8/8/8/8/8/8/4K2R w - - 0 1")
+        core.rhmc = 0xFFFFFF
+        core.flag = chess.WCASTLE + chess.BCASTLE
+        core:make_move(chess.MOVE(squarei"h1", squarei"h2"))
+        core:unmake_move()
+        assert(core.rhmc == 0xFFFFFF and core.flag == 15)
+    end
+    function TestBoard:test_02_unmake_empty()
+        local core = chess.board.new()
+        assert(not pcall(core.unmake_move, core))
+        assert(not pcall(core.make_move, core, chess.MOVE(squarei"e2", squarei"e4")))
+    end
+    function TestBoard:test_03_make_unmake_restores()
+        local board = chess.Board{}
+        board:loadfen()
+        local fen = board:fen()
+        local occupied, pieces = {}, {}
+        for i=1,3 do occupied[i] = board.bitboard.occupied[i] end
+        for _, smove in ipairs{"e4", "e5", "Nf3", "Nc6", "Bb5", "a6", "O-O"} do
+            board:move_san(smove)
+        end
+        assert(#board.movelist == 8)
+        assert(board.movelist[1][1] == NULLMOVE)
+        for i=1,7 do board:unmake_move() end
+        assert(board:fen() == fen)
+        for i=1,3 do assert(board.bitboard.occupied[i] == occupied[i], i) end
+        assert(#board.movelist == 0)
+    end
+    function TestBoard:test_04_fischerandom_castle()
+        -- King on f1, rooks on g1 and a1.
+        local board = chess.Board{li_king = squarei"f1",
+            li_rook = {squarei"g1", squarei"a1"}}
+        board:set_piece(squarei"f1", KING, WHITE)
+        board:set_piece(squarei"g1", ROOK, WHITE)
+        board:set_piece(squarei"a1", ROOK, WHITE)
+        board:set_piece(squarei"f8", KING, BLACK)
+        board.flag = chess.WCASTLE
+
+        board:make_move(bor(chess.MOVE(squarei"f1", squarei"g1"), CASTLING))
+        assert(board:get_piece(squarei"g1") == KING)
+        assert(board:get_piece(squarei"f1") == ROOK)
+        assert(board.flag == 0)
+        board:unmake_move()
+        assert(board:get_piece(squarei"f1") == KING)
+        assert(board:get_piece(squarei"g1") == ROOK)
+        assert(board.flag == chess.WCASTLE)
+    end
+    function TestBoard:test_05_generate_start()
+        local board = chess.Board{}
+        board:loadfen()
+        assert(#board:legal_moves() == 20)
+        assert(#board:pseudo_moves() == 20)
+        assert(not board:in_check())
+        assert(perft(board, 3) == 8902)
+    end
+    function TestBoard:test_06_generate_kiwipete()
+        local board = chess.Board{}
+        board:loadfen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1")
+        assert(#board:legal_moves() == 48)
+        assert(perft(board, 2) == 2039)
+    end
+    function TestBoard:test_07_generate_pins()
+        -- The en passant capture would expose the king on the fifth rank.
+        local board = chess.Board{}
+        board:loadfen("8/8/8/KPp4r/8/8/8/4k3 w - c6 0 2")
+        for _, m in ipairs(board:legal_moves()) do
+            assert(bit.band(m, chess.ENPASSANT) == 0)
+        end
+        local found = false
+        for _, m in ipairs(board:pseudo_moves()) do
+            if bit.band(m, chess.ENPASSANT) ~= 0 then found = true end
+        end
+        assert(found)
+
+        -- Position 3 of the standard perft suite is full of pins.
+        board:loadfen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1")
+        assert(perft(board, 3) == 2812)
+    end
+    function TestBoard:test_08_generate_fischerandom_castle()
+        local board = chess.Board{li_king = squarei"g1",
+            li_rook = {squarei"h1", squarei"f1"}}
+        board:loadfen("bqnb1rkr/pp3ppp/3ppn2/2p5/5P2/P2P4/NPP1P1PP/BQ1BNRKR w KQkq - 2 9")
+        assert(#board:legal_moves() == 21)
+        assert(perft(board, 3) == 12189)
+    end
+    function TestBoard:test_09_generate_legal_pawn_moves()
+        local board = chess.Board{}
+        board:loadfen("4k3/1P6/8/8/8/8/4P3/4K3 w - - 0 1")
+        assert(#board:generate_legal_pawn_moves(squarei"e2") == 2)
+        assert(#board:generate_legal_pawn_moves(squarei"b7") == 4)
+        assert(#board:generate_legal_pawn_moves(squarei"b7", true) == 5)
+    end
+    function TestBoard:test_10_key()
+        local board = chess.Board{}
+        assert(board.key == bb(0))
+        board:loadfen()
+        local key = board.key
+        assert(key ~= bb(0))
+        board.side = BLACK
+        assert(board.key ~= key)
+        board.side = WHITE
+        assert(board.key == key)
+
+        for _, smove in ipairs{"e4", "c5", "Nf3", "d6", "d4", "cxd4", "Be2", "Nf6",
+                "O-O"} do
+            board:move_san(smove)
+        end
+        local fen, played = board:fen(), board.key
+        for i=1,9 do board:unmake_move() end
+        assert(board.key == key)
+
+        -- Keys computed from scratch agree with the incremental ones.
+        board:loadfen(fen)
+        assert(board.key == played)
+    end
+    function TestBoard:test_11_key_transposition()
+        local b1, b2 = chess.Board{}, chess.Board{}
+        b1:loadfen()
+        b2:loadfen()
+        for _, smove in ipairs{"Nf3", "Nf6", "Nc3", "Nc6"} do b1:move_san(smove) end
+        for _, smove in ipairs{"Nc3", "Nc6", "Nf3", "Nf6"} do b2:move_san(smove) end
+        assert(b1.key == b2.key)
+        local seen = {[b1.key:tokey()] = true}
+        assert(seen[b2.key:tokey()])
+
+        -- En passant square is part of the key.
+        b1:loadfen()
+        b1:move_san("e4")
+        b2:loadfen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1")
+        assert(b1.key ~= b2.key)
+        b2.ep = squarei"e3"
+        assert(b1.key == b2.key)
+    end
+    function TestBoard:test_12_long_history()
+        -- The history grows past its initial size and unmaking restores
+        -- captures and the key.
+        local board = chess.Board{}
+        board:loadfen()
+        local core = board.core
+        local key, fen = board.key, board:fen()
+        local shuffle = {}
+        for _, m in ipairs{{"g1", "f3"}, {"g8", "f6"}, {"f3", "g1"}, {"f6", "g8"}} do
+            shuffle[#shuffle + 1] = chess.MOVE(squarei(m[1]), squarei(m[2]))
+        end
+        for i=1,1200 do core:make_move(shuffle[(i - 1) % 4 + 1]) end
+        assert(board.key == key)
+        assert(#core:history() == 1201)
+        board:move_san("e4")
+        board:move_san("d5")
+        board:move_san("exd5")
+        local captured = board.key
+        board:move_san("Qxd5")
+        board:unmake_move()
+        assert(board.key == captured)
+        for i=1,1203 do core:unmake_move() end
+        assert(board.key == key)
+        assert(board:fen() == fen)
+        assert(not pcall(core.unmake_move, core))
+    end
+    function TestBoard:test_13_fen()
+        local core = chess.board.new()
+        for _, fen in ipairs{
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w KQkq d6 0 3",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq - 12 40",
+            "8/8/8/8/8/8/8/8 w - - 0 1",
+        } do
+            assert(core:loadfen(fen))
+            assert(core:fen() == fen, fen)
+        end
+        -- The key matches the one built piece by piece.
+        local board = chess.Board{}
+        board:loadfen("8/8/8/KPp4r/8/8/8/4k3 w - c6 0 2")
+        local key = board.key
+        board:clear_all()
+        board.side = WHITE
+        for _, p in ipairs{{"a5", KING, WHITE}, {"b5", PAWN, WHITE},
+                {"c5", PAWN, BLACK}, {"h5", ROOK, BLACK}, {"e1", KING, BLACK}} do
+            board:set_piece(squarei(p[1]), p[2], p[3])
+        end
+        board.ep = squarei"c6"
+        assert(board.key == key)
+        -- Trailing text is ignored.
+        assert(core:loadfen("8/8/8/8/8/8/8/4K2k b - - 3 7 bm Kf2;"))
+        assert(core:fen() == "8/8/8/8/8/8/8/4K2k b - - 3 7")
+    end
+    function TestBoard:test_14_fen_errors()
+        local core = chess.board.new()
+        local start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+        assert(core:loadfen(start))
+        for fen, offset in pairs{
+            ["rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR"] = 44,
+            ["rnbqkbnr/ppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"] = 17,
+            ["rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"] = 19,
+            ["rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNRR w KQkq - 0 1"] = 44,
+            ["rnbqkbnr/pppxpppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"] = 13,
+            ["rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1"] = 45,
+            ["rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQxq - 0 1"] = 49,
+            ["rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e4 0 1"] = 53,
+            ["rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0"] = 55,
+            ["rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - a 1"] = 54,
+        } do
+            local ok, err, pos = core:loadfen(fen)
+            assert(ok == nil and type(err) == "string", fen)
+            assert(pos == offset, fen .. ": " .. err .. " at " .. pos)
+            -- The board is left untouched.
+            assert(core:fen() == start)
+        end
+        assert(not pcall(core.loadfen, core, {}))
+        local board = chess.Board{}
+        local ok, err = pcall(board.loadfen, board, "8/8/8 w - - 0 1")
+        assert(not ok and err:find("invalid fen: .* at byte 6"), err)
+    end
+    function TestBoard:test_15_crowded()
+        -- Positions built piece by piece or loaded from FENs may have more
+        -- moves than any legal position.
+        local board = chess.Board{}
+        for sq=0,63 do
+            if sq ~= squarei"h8" then board:set_piece(sq, chess.QUEEN, WHITE) end
+        end
+        board:set_piece(squarei"h8", KING, BLACK)
+        assert(#board:pseudo_moves() == 3)
+        -- Queens all around the edge have 288 moves.
+        board:clear_all()
+        board.side = WHITE
+        for sq=0,63 do
+            local f, r = sq % 8, math.floor(sq / 8)
+            if f == 0 or f == 7 or r == 0 or r == 7 then
+                board:set_piece(sq, chess.QUEEN, WHITE)
+            end
+        end
+        assert(#board:pseudo_moves() == 288)
+        assert(#board:legal_moves() == 288)
+        assert(board.core:perft(1) == 288)
+        local core = chess.board.new()
+        assert(core:loadfen("QQQQQQQQ/Q6Q/Q6Q/Q6Q/Q6Q/Q6Q/Q6Q/QQQQQQQQ w - - 0 1"))
+        assert(core:perft(1) == 288)
+    end
+    function TestBoard:test_16_readonly_views()
+        local board = chess.Board{}
+        board:loadfen()
+        assert(not pcall(function() board.cboard[1] = 1 end))
+        assert(not pcall(function() board.bitboard.occupied = {} end))
+        assert(not pcall(function() board.bitboard.pieces[chess.WHITE][chess.PAWN] = 0 end))
+        assert(not pcall(function() board.movelist = {} end))
+        assert(not pcall(function() board.bitboard.occupied[4]:setbit(0) end))
+        assert(not pcall(function() board.bitboard.pieces[chess.WHITE][chess.PAWN]:clrbit(8) end))
+
+        local copy = board.bitboard.occupied[3]:copy()
+        copy:clrbit(0)
+        assert(board.bitboard.occupied[3]:tstbit(0))
+        assert(not copy:tstbit(0))
+        assert(board.cboard[1] ~= nil)
+    end
+    function TestBoard:test_17_movelist_cache()
+        local board = chess.Board{}
+        board:loadfen()
+        local movelist = board.movelist
+        assert(#movelist == 0)
+        assert(board.movelist == movelist)
+
+        board:move_san("e4")
+        assert(board.movelist ~= movelist)
+        movelist = board.movelist
+        assert(#movelist == 2)
+        assert(board.movelist == movelist)
+
+        board:move_san("e5")
+        assert(#board.movelist == 3)
+        board:loadfen()
+        assert(#board.movelist == 0)
+    end
+-- class
+
+ret = LuaUnit:run()
+if ret > 0 then os.exit(1) end
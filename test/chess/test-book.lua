@@ -0,0 +1,136 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Unit tests for chess.book
+-- Requires luaunit.
+
+require "luaunit"
+require "customloaders"
+
+require "bit"
+require "chess"
+require "chess.book"
+
+local bor = bit.bor
+local book = chess.book
+local squarei = chess.squarei
+local MOVE = chess.MOVE
+
+-- Returns the Polyglot key of a board as 16 hex digits.
+local function hexkey(board)
+    return tostring(book.key(board)):sub(-16)
+end
+
+-- Packs an entry of a Polyglot book.
+local function entry(hex, pm, weight)
+    local s = hex:gsub("%x%x", function (h) return string.char(tonumber(h, 16)) end)
+    return s .. string.char(math.floor(pm / 256), pm % 256,
+        math.floor(weight / 256), weight % 256, 0, 0, 0, 0)
+end
+
+-- Writes a book of {board, from, to, weight, promotion} entries.
+local function write_book(name, entries)
+    -- Entries of a position keep their order.
+    for i, e in ipairs(entries) do e.i = i end
+    table.sort(entries, function (a, b)
+        if a[1] ~= b[1] then return a[1] < b[1] end
+        return a.i < b.i
+    end)
+    local file = assert(io.open(name, "wb"))
+    for _, e in ipairs(entries) do
+        local pm = squarei(e[3]) + squarei(e[2]) * 64 + (e[5] or 0) * 4096
+        file:write(entry(e[1], pm, e[4]))
+    end
+    file:close()
+end
+
+TestBook = {} -- class
+    function TestBook:test_01_key()
+        -- Test positions of the Polyglot book format.
+        local board = chess.Board{}
+        board:loadfen()
+        assert(hexkey(board) == "463b96181691fc9c")
+        local expected = {"823c9b50fd114196", "0756b94461c50fb0", "662fafb965db29d4",
+            "22a48b5a8e47ff78", "652a607ca3f242c1", "00fdd303c946bdd9"}
+        for i, san in ipairs{"e4", "d5", "e5", "f5", "Ke2", "Kf7"} do
+            board:make_move(board.core:parse_san(san))
+            assert(hexkey(board) == expected[i], san)
+        end
+        board:loadfen()
+        expected = {"3c8123ea7b067637", "5c3f9b829b279560"}
+        for i, san in ipairs{"a4", "b5", "h4", "b4", "c4", "bxc3", "Ra3"} do
+            board:make_move(board.core:parse_san(san))
+            if i == 5 then assert(hexkey(board) == expected[1]) end
+        end
+        assert(hexkey(board) == expected[2])
+        assert(hexkey(board.core) == expected[2])
+    end
+    function TestBook:test_02_moves()
+        local board = chess.Board{}
+        local name = os.tmpname()
+        board:loadfen()
+        local start = hexkey(board)
+        board:loadfen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1")
+        local castle = hexkey(board)
+        board:loadfen("8/P7/8/8/8/8/8/k6K w - - 0 1")
+        local promote = hexkey(board)
+        write_book(name, {
+            {start, "e2", "e4", 10}, {start, "d2", "d4", 5}, {start, "e2", "e5", 100},
+            {start, "a2", "a3", 0}, {castle, "e1", "h1", 1}, {castle, "e1", "a1", 3},
+            {promote, "a7", "a8", 1, 4}, {"0000000000000001", "e2", "e4", 1}})
+
+        local bk = assert(book.open(name))
+        assert(#bk == 8 and bk:count() == 8)
+        board:loadfen()
+        local moves, weights = bk:moves(board)
+        assert(#moves == 3 and #weights == 3)
+        assert(moves[1] == MOVE(squarei"e2", squarei"e4") and weights[1] == 10)
+        assert(moves[2] == MOVE(squarei"d2", squarei"d4") and weights[2] == 5)
+        assert(moves[3] == MOVE(squarei"a2", squarei"a3") and weights[3] == 0)
+        assert(bk:pick(board) == MOVE(squarei"e2", squarei"e4"))
+        assert(bk:pick(board, 0) == MOVE(squarei"e2", squarei"e4"))
+        local m, w = bk:pick(board, 0.9)
+        assert(m == MOVE(squarei"d2", squarei"d4") and w == 5)
+
+        -- Reused arrays are cleared past the moves.
+        board:loadfen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1")
+        local ms, ws = {1, 2, 3, 4}, {1, 2, 3, 4}
+        assert(rawequal(bk:moves(board.core, ms, ws), ms))
+        assert(#ms == 2 and #ws == 2 and ms[3] == nil and ws[4] == nil)
+        assert(ms[1] == bor(MOVE(squarei"e1", squarei"g1"), chess.CASTLING))
+        assert(ms[2] == bor(MOVE(squarei"e1", squarei"c1"), chess.CASTLING))
+        assert(bk:pick(board) == ms[2])
+
+        board:loadfen("8/P7/8/8/8/8/8/k6K w - - 0 1")
+        assert(bk:pick(board) == bor(MOVE(squarei"a7", squarei"a8"), chess.QUEENPRM))
+        board:loadfen("8/8/8/8/8/8/8/k6K w - - 0 1")
+        assert(bk:pick(board) == nil and #bk:moves(board) == 0)
+        bk:close()
+        assert(not pcall(bk.count, bk))
+
+        local file = assert(io.open(name, "ab"))
+        file:write("x")
+        file:close()
+        local bk, err = book.open(name)
+        assert(not bk and err, err)
+        os.remove(name)
+    end
+-- class
+
+ret = LuaUnit:run()
+if ret > 0 then os.exit(1) end
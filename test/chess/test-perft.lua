@@ -0,0 +1,55 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Perft tests, checks node counts of the reference positions and reports
+-- nodes per second.
+-- Requires luaunit.
+
+require "luaunit"
+require "customloaders"
+
+require "chess"
+require "chess.perft"
+
+local perft = chess.perft
+
+TestPerft = {} -- class
+    function TestPerft:test_01_c()
+        assert(perft.run("c", 200000, true))
+    end
+    function TestPerft:test_02_lua()
+        assert(perft.run("lua", 10000, true))
+    end
+    function TestPerft:test_03_divide()
+        local board = chess.Board{}
+        board:loadfen(perft.positions[2].fen)
+        local div, total = board.core:divide(2)
+        assert(total == 2039)
+        local ldiv, ltotal = board:divide(2)
+        assert(ltotal == 2039)
+        local n = 0
+        for m, nodes in pairs(div) do
+            assert(ldiv[m] == nodes)
+            n = n + 1
+        end
+        assert(n == 48)
+    end
+-- class
+
+ret = LuaUnit:run()
+if ret > 0 then os.exit(1) end
@@ -0,0 +1,329 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Unit tests for chess.pgn
+-- Requires luaunit.
+
+require "luaunit"
+require "customloaders"
+
+require "bit"
+require "chess"
+require "chess.pgn"
+
+local bor = bit.bor
+local pgn = chess.pgn
+local squarei = chess.squarei
+local MOVE = chess.MOVE
+
+-- Returns a source reading the string s.
+local function source(s)
+    local pos = 1
+    return function (n)
+        if pos > #s then return nil end
+        local chunk = s:sub(pos, pos + n - 1)
+        pos = pos + n
+        return chunk
+    end
+end
+
+local fischer_tal = [[
+[Event "Leipzig Olympiad"]
+[Site "Leipzig GDR"]
+[Date "1960.11.01"]
+[White "Fischer, Robert James"]
+[Black "Tal, Mikhail"]
+[Result "1/2-1/2"]
+
+1. e4 e6 2. d4 d5 3. Nc3 Bb4 4. e5 c5 5. a3 Ba5 6. b4 cxd4 7. Qg4 Ne7
+8. bxa5 dxc3 9. Qxg7 Rg8 10. Qxh7 Nbc6 11. Nf3 Qc7 12. Bb5 Bd7 13. O-O O-O-O
+14. Bg5 Nxe5 15. Nxe5 Bxb5 16. Nxf7 Bxf1 17. Nxd8 Rxg5 18. Nxe6 Rxg2+ 19. Kh1
+Qe5 20. Rxf1 Qxe6 21. Kxg2 Qg4+ 1/2-1/2
+]]
+
+TestPgn = {} -- class
+    function TestPgn:test_01_tokens()
+        local text = '[Event "A \\"quoted\\" name"]\n' ..
+            '{Opening} 1. e4 $1 e5!? (1... c5 {Sicilian}) 2. Nf3 ; rest\n' ..
+            '% escaped line\n' ..
+            '2... Nc6 *\n'
+        local expected = {
+            {"tag", "Event", 'A "quoted" name'},
+            {"comment", "Opening"},
+            {"san", "e4"}, {"nag", 1},
+            {"san", "e5"}, {"nag", 5},
+            {"("}, {"san", "c5"}, {"comment", "Sicilian"}, {")"},
+            {"san", "Nf3"}, {"comment", " rest"},
+            {"san", "Nc6"},
+            {"result", "*"},
+        }
+        -- Every chunk size gives the same tokens.
+        for size=1,#text + 1 do
+            local i = 0
+            for t, v, w in pgn.tokens(source(text), size) do
+                i = i + 1
+                local e = expected[i]
+                assert(e, "extra token " .. t)
+                assert(t == e[1] and v == e[2] and w == e[3],
+                    "chunk size " .. size .. " token " .. i .. " " .. t)
+            end
+            assert(i == #expected, "chunk size " .. size)
+        end
+    end
+    function TestPgn:test_02_games()
+        local text = fischer_tal .. "\n" ..
+            '[Event "No result"]\n\n1. d4 {Queen pawn} d5 (1... Nf6 2. c4) 2. c4 $2\n' ..
+            '[Event "Last"]\n\n1. e4 0-1'
+        local games = {}
+        for game in pgn.games(source(text), 16) do games[#games + 1] = game end
+        assert(#games == 3)
+        assert(games[1].tags.Black == "Tal, Mikhail")
+        assert(#games[1].moves == 42)
+        assert(games[1].moves[26] == "O-O-O")
+        assert(games[1].result == "1/2-1/2")
+        assert(games[2].tags.Event == "No result")
+        assert(games[2].result == nil)
+        assert(#games[2].moves == 3)
+        assert(games[2].comments[1] == "Queen pawn")
+        assert(games[2].nags[3][1] == 2)
+        assert(games[3].tags.Event == "Last")
+        assert(games[3].moves[1] == "e4")
+        assert(games[3].result == "0-1")
+    end
+    function TestPgn:test_03_replay()
+        local game = pgn.games(source(fischer_tal))()
+        local board = chess.Board{}
+        local last
+        for ply, m, b in pgn.replay(game, board) do
+            assert(b == board)
+            last = ply
+        end
+        assert(last == 42)
+        assert(board:fen() == "2k5/pp2n2Q/8/P2p4/6q1/P1p5/2P2PKP/5R2 w - - 1 22")
+    end
+    function TestPgn:test_04_replay_fen()
+        -- The knight on c3 is pinned so Ne4 is not ambiguous.
+        local text = '[FEN "4k3/8/8/4b3/8/2N3N1/8/K7 w - - 0 1"]\n\n1. Ne4 *'
+        local game = pgn.games(source(text))()
+        for ply, m in pgn.replay(game) do
+            assert(m == MOVE(squarei"g3", squarei"e4"))
+        end
+        text = '[FEN "4k3/8/8/8/8/2N3N1/8/K7 w - - 0 1"]\n\n1. Ne4 *'
+        game = pgn.games(source(text))()
+        local ok, err = pcall(function ()
+            for ply in pgn.replay(game) do end
+        end)
+        assert(not ok and err:find("ambiguous move 'Ne4' at ply 1"), err)
+    end
+    function TestPgn:test_05_positions()
+        local text = fischer_tal .. "\n" .. fischer_tal
+        local count, games, last = 0, 0, nil
+        for game, ply, m, board in pgn.positions(source(text), nil, 100) do
+            count = count + 1
+            if game ~= last then games = games + 1 end
+            last = game
+        end
+        assert(count == 84)
+        assert(games == 2)
+    end
+    function TestPgn:test_06_parse_san()
+        local board = chess.Board{}
+        board:loadfen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1")
+        local core = board.core
+        assert(core:parse_san("O-O") == bor(MOVE(squarei"e1", squarei"g1"), chess.CASTLING))
+        assert(core:parse_san("0-0-0") == bor(MOVE(squarei"e1", squarei"c1"), chess.CASTLING))
+        assert(core:parse_san("Nxf7+!") ==
+            bor(MOVE(squarei"e5", squarei"f7"), chess.PAWNCAP))
+        assert(core:parse_san("Ne5-d3") == MOVE(squarei"e5", squarei"d3"))
+        assert(core:parse_san("a4") == MOVE(squarei"a2", squarei"a4"))
+        assert(core:parse_san("dxe6") ==
+            bor(MOVE(squarei"d5", squarei"e6"), chess.PAWNCAP))
+        assert(not core:parse_san("Nb5x"))
+        assert(select(2, core:parse_san("Ke3")) == "illegal move")
+        board:loadfen("4k3/1P6/8/8/8/8/8/4K3 w - - 0 1")
+        assert(core:parse_san("b8=N") ==
+            bor(MOVE(squarei"b7", squarei"b8"), chess.KNIGHTPRM))
+        assert(core:parse_san("b8Q") ==
+            bor(MOVE(squarei"b7", squarei"b8"), chess.QUEENPRM))
+        assert(not core:parse_san("b8"))
+    end
+    function TestPgn:test_07_db()
+        local ep = '[Event "En passant"]\n[FEN "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1"]\n\n' ..
+            '1. exd6 Kd7 2. Kd2 Kxd6 *\n'
+        local name = os.tmpname()
+        assert(pgn.write_db(source(fischer_tal .. "\n" .. ep), name) == 2)
+
+        local db = assert(chess.board.opendb(name))
+        assert(#db == 2 and db:count() == 2)
+        assert(db:tags(1).Black == "Tal, Mikhail")
+        assert(db:tags(2).FEN == "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1")
+        assert(db:nmoves(1) == 42 and db:nmoves(2) == 4)
+
+        local board = chess.Board{}
+        assert(db:replay(1, board) == 42)
+        assert(board:fen() == "2k5/pp2n2Q/8/P2p4/6q1/P1p5/2P2PKP/5R2 w - - 1 22")
+        assert(db:replay(1, board, 2) == 2)
+        assert(board:fen() == "rnbqkbnr/pppp1ppp/4p3/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2")
+
+        -- The moves are the same as the ones of the PGN, captures included.
+        local game = pgn.games(source(fischer_tal))()
+        local moves = db:moves(1, board.core)
+        for ply, m in pgn.replay(game) do assert(moves[ply] == m, ply) end
+        moves = db:moves(2, board)
+        assert(moves[1] == bor(MOVE(squarei"e5", squarei"d6"), chess.ENPASSANT))
+        assert(board:fen() == "8/8/3k4/8/8/8/3K4/8 w - - 0 3")
+        assert(not pcall(db.tags, db, 3))
+        db:close()
+        os.remove(name)
+
+        local file = assert(io.open(name, "wb"))
+        file:write(fischer_tal)
+        file:close()
+        local db, err = chess.board.opendb(name)
+        os.remove(name)
+        assert(not db and err, err)
+    end
+    function TestPgn:test_08_index()
+        local french = '[Event "French"]\n\n1. e4 e6 2. d4 d5 3. exd5 exd5 *\n'
+        local ep = '[Event "En passant"]\n[FEN "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1"]\n\n' ..
+            '1. exd6 Kd7 *\n'
+        local dbname, ixname = os.tmpname(), os.tmpname()
+        pgn.write_db(source(fischer_tal .. "\n" .. french .. "\n" .. ep), dbname)
+        local db = assert(chess.board.opendb(dbname))
+        assert(chess.board.buildindex(db, ixname) == 43 + 7 + 3)
+
+        local ix = assert(chess.board.openindex(ixname))
+        assert(#ix == 53)
+        local games, plies = ix:find("rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w KQkq d6 0 3")
+        assert(#games == 2 and games[1] == 1 and games[2] == 2)
+        assert(plies[1] == 4 and plies[2] == 4)
+        games = ix:find("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 1)
+        assert(#games == 1)
+
+        -- The en passant file counts only if a pawn can capture on it.
+        for _, ep in ipairs{"-", "e3"} do
+            games, plies = ix:find("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq " .. ep .. " 0 1")
+            assert(#games == 2 and plies[1] == 1 and plies[2] == 1, ep)
+        end
+        games = ix:find("rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w KQkq - 0 3")
+        assert(#games == 2)
+        assert(#ix:find("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1") == 1)
+        assert(#ix:find("4k3/8/8/3pP3/8/8/8/4K3 w - - 0 1") == 0)
+
+        -- Every position of a game is found at its ply.
+        local board = chess.Board{}
+        for ply=0,db:nmoves(1) do
+            db:replay(1, board, ply)
+            local found = false
+            games, plies = ix:find(board)
+            for i=1,#games do
+                if games[i] == 1 and plies[i] == ply then found = true end
+            end
+            assert(found, ply)
+        end
+        assert(#ix:find("8/8/8/8/8/8/8/K1k5 w - - 0 1") == 0)
+
+        -- French exchange: the first capture leaves black a pawn down.
+        games, plies = ix:material("KQRRBBNNPPPPPPPPkqrrbbnnppppppp")
+        assert(#games == 1 and games[1] == 2 and plies[1] == 5)
+        games, plies = ix:material(board)
+        assert(#games == 1 and games[1] == 1 and plies[1] == 42 - 1)
+        games, plies = ix:material("KPk")
+        assert(#games == 1 and games[1] == 3 and plies[1] == 1)
+        assert(not pcall(ix.material, ix, "KXk"))
+        assert(not pcall(ix.find, ix, "not a fen"))
+        ix:close()
+
+        -- Building with little memory merges sorted runs from disk into the
+        -- same file.
+        local small = os.tmpname()
+        assert(chess.board.buildindex(db, small, 0) == 53)
+        local file = assert(io.open(ixname, "rb"))
+        local whole = file:read("*a")
+        file:close()
+        file = assert(io.open(small, "rb"))
+        assert(file:read("*a") == whole)
+        file:close()
+        os.remove(small)
+        db:close()
+        os.remove(dbname)
+
+        local ix, err = chess.board.openindex(ixname .. ".missing")
+        assert(not ix and err, err)
+        os.remove(ixname)
+    end
+    function TestPgn:test_09_db_writer()
+        local name = os.tmpname()
+        local e4, e5 = MOVE(squarei"e2", squarei"e4"), MOVE(squarei"e7", squarei"e5")
+        local writer = assert(chess.board.newdb(name))
+        assert(writer:add({Event = "One"}, {e4, e5}) == 1)
+        -- A bad move is found before anything is written.
+        local ok, err = pcall(writer.add, writer, {Event = "Bad"}, {e4, "e5"})
+        assert(not ok and err:find("move 2 is not a number"), err)
+        assert(writer:add({Event = "Two"}, {e4}) == 2)
+        -- So are illegal moves and promotions to nothing.
+        ok, err = pcall(writer.add, writer, {}, {e4, MOVE(squarei"d8", squarei"d7")})
+        assert(not ok and err:find("move 2: illegal move"), err)
+        ok, err = pcall(writer.add, writer, {}, {bor(e4, 0x7000)})
+        assert(not ok and err:find("move 1: illegal move"), err)
+        ok, err = pcall(writer.add, writer, {FEN = "4k3/8/8/8/8/8/8/4K3 b - - 0 1"}, {e4})
+        assert(not ok and err:find("move 1: illegal move"), err)
+        ok, err = pcall(writer.add, writer, {FEN = "8/8 w - - 0 1"}, {})
+        assert(not ok and err:find("invalid fen"), err)
+        assert(writer:close())
+
+        local db = assert(chess.board.opendb(name))
+        assert(#db == 2)
+        assert(db:tags(2).Event == "Two" and db:nmoves(2) == 1)
+        db:close()
+
+        -- An offset close to 2^64 doesn't wrap around the bounds check, the
+        -- index of the one game starts right after it.
+        writer = assert(chess.board.newdb(name))
+        writer:add({}, {})
+        writer:close()
+        local file = assert(io.open(name, "r+b"))
+        file:seek("set", 24 + 8)
+        file:write(string.rep("\255", 8))
+        file:close()
+        db = assert(chess.board.opendb(name))
+        ok, err = pcall(db.tags, db, 1)
+        assert(not ok and err:find("corrupt"), err)
+        db:close()
+
+        -- Stored moves are replayed only if they're legal.
+        writer = assert(chess.board.newdb(name))
+        writer:add({}, {e4})
+        writer:close()
+        file = assert(io.open(name, "r+b"))
+        file:seek("set", 24 + 8)
+        file:write(string.char(e4 % 256, 0x70 + math.floor(e4 / 256)))
+        file:close()
+        db = assert(chess.board.opendb(name))
+        local board = chess.Board{}
+        ok, err = pcall(db.replay, db, 1, board, 1)
+        assert(not ok and err:find("game 1: illegal move"), err)
+        ok, err = pcall(db.moves, db, 1, board)
+        assert(not ok and err:find("game 1: illegal move"), err)
+        db:close()
+        os.remove(name)
+    end
+-- class
+
+ret = LuaUnit:run()
+if ret > 0 then os.exit(1) end
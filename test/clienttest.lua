@@ -0,0 +1,46 @@
+#!/usr/bin/env lua
+-- Helpers for the tests of the chess.fics and chess.icc clients.
+-- vim: set et sts=4 sw=4 ts=4 fdm=marker:
+
+local clienttest = {}
+
+-- Returns the lines the client queued.
+function clienttest.drain(c)
+    local lines = {}
+    while c._lines_first <= c._lines_last do
+        local line = c._lines[c._lines_first]
+        table.insert(lines, line)
+        c._lines[c._lines_first] = nil
+        c._lines_first = c._lines_first + 1
+    end
+    return lines
+end
+
+function clienttest.same(a, b)
+    if #a ~= #b then return false end
+    for i=1,#a do
+        if a[i] ~= b[i] then return false end
+    end
+    return true
+end
+
+-- Feeds stream to new clients split at every byte and then a byte at a time,
+-- every client must queue the expected lines and keep nothing back.
+function clienttest.feed_every_boundary(new, stream, expected)
+    local drain, same = clienttest.drain, clienttest.same
+
+    for i=0,#stream do
+        local c = new()
+        c:feed(stream:sub(1, i))
+        c:feed(stream:sub(i + 1))
+        assert(same(drain(c), expected), i)
+        assert(c._linebuf == "", i)
+    end
+
+    local c = new()
+    for i=1,#stream do c:feed(stream:sub(i, i)) end
+    assert(same(drain(c), expected))
+    assert(c._linebuf == "")
+end
+
+return clienttest
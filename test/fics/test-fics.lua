@@ -0,0 +1,137 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Unit tests for chess.fics
+-- Requires luaunit.
+
+require "luaunit"
+require "customloaders"
+
+-- The clients are never connected, LuaSocket isn't needed.
+if not pcall(require, "socket") then package.loaded.socket = {} end
+require "chess.fics"
+local clienttest = require "clienttest"
+
+local fics = chess.fics
+local utils = chess.fics.utils
+local parser = chess.fics.parser
+local same = clienttest.same
+
+local stream = "login: \n\rGuestABCD logged in.\n\r" ..
+    "12:34_fics% \n\r[G]\n\r<12> x\r\n" ..
+    "password: \n\rfics% tell me\n\r"
+local expected = {"login: ", "", "GuestABCD logged in.", "12:34_fics% ", "",
+    false, "<12> x", "password: ", "", "fics% ", "tell me"}
+
+local style12 = "<12> rnbqkb-r pppppppp -----n-- -------- ----P--- -------- " ..
+    "PPPPKPPP RNBQ-BNR B -1 0 0 1 1 0 7 Newton Einstein 1 2 12 39 39 119 122 " ..
+    "2 K/e1-e2 (0:06) Ke2 0"
+local move = "Game 7: Newton moves: Ke2"
+
+TestFics = {} -- class
+    function TestFics:test_01_split_lines()
+        local lines, rest = utils.split_lines(stream, true)
+        assert(same(lines, expected))
+        assert(rest == "")
+
+        -- Without timeseal pings are ordinary lines.
+        lines = utils.split_lines(stream, false)
+        assert(lines[6] == "[G]")
+
+        -- The partial last line is returned as the rest.
+        lines, rest = utils.split_lines("fics% foo\n\rbar", true)
+        assert(same(lines, {"fics% ", "foo"}))
+        assert(rest == "bar")
+        lines, rest = utils.split_lines("12:3", true)
+        assert(#lines == 0 and rest == "12:3")
+    end
+    function TestFics:test_02_feed_every_boundary()
+        -- Splitting the data anywhere gives the same lines.
+        clienttest.feed_every_boundary(function ()
+            return fics.client:new{timeseal = true}
+        end, stream, expected)
+    end
+    function TestFics:test_03_ping()
+        local sent = {}
+        local c = fics.client:new{}
+        c.sock = {send = function (sock, data) table.insert(sent, data) return #data end}
+        c:feed("[G]\n\rfoo\n\r")
+        assert(#sent == 0)
+        local line, errmsg = c:nextline()
+        assert(line == "[G]")
+
+        c.timeseal = true
+        c:feed("[G]\n\rfoo\n\r")
+        line, errmsg = c:nextline()
+        assert(line == "foo")
+        line, errmsg = c:nextline()
+        assert(line == nil and errmsg == "internal")
+        assert(#sent == 1)
+        assert(c:nextline() == "foo")
+        assert(c:nextline() == nil)
+    end
+    function TestFics:test_04_parser_dispatch()
+        local c = fics.client:new{}
+        local games, moves = {}, {}
+
+        -- Without callbacks the lines aren't parsed.
+        c:generate_parser()
+        assert(c._parser:match(style12) == nil)
+        assert(c._parser:match(move) == nil)
+        assert(c:parseline(style12))
+        assert(c:parseline(move))
+
+        local index = c:register_callback("style12", function (client, line, game)
+            table.insert(games, game)
+        end)
+        assert(c:parseline(style12))
+        assert(c:parseline(move))
+        assert(#games == 1 and #moves == 0)
+        assert(games[1].white_name == "Newton" and games[1].black_name == "Einstein")
+        assert(games[1].last_move == "Ke2" and games[1].tomove == "B")
+        local board = games[1].board
+        assert(board.a8 == "r" and board.f6 == "n" and board.e4 == "P")
+        assert(board.e2 == "K" and board.e1 == "-" and board.h1 == "R")
+
+        c:register_callback("move", function (client, line, no, handle, san)
+            table.insert(moves, {no, handle, san})
+        end)
+        assert(c:parseline(move))
+        assert(#moves == 1)
+        assert(moves[1][1] == 7 and moves[1][2] == "Newton" and moves[1][3] == "Ke2")
+
+        -- Removing the callback regenerates the parser.
+        assert(c:remove_callback(index))
+        assert(c:parseline(style12))
+        assert(#games == 1)
+        assert(c._parser:match(style12) == nil)
+        assert(c._parser:match(move)[1] == parser.MOVE)
+
+        -- Line callbacks see every line parsed.
+        local groups = {}
+        c:register_callback("line", function (client, group, line)
+            table.insert(groups, group or false)
+        end)
+        assert(c:parseline(style12))
+        assert(c:parseline("foo"))
+        assert(same(groups, {"style12", false}))
+    end
+-- class
+
+ret = LuaUnit:run()
+if ret > 0 then os.exit(1) end
@@ -0,0 +1,168 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Unit tests for chess.fics.reactor
+-- Requires luaunit.
+
+require "luaunit"
+require "customloaders"
+
+if not pcall(require, "socket") then package.loaded.socket = {} end
+require "sockpair"
+require "chess.fics"
+require "chess.fics.reactor"
+
+local fics = chess.fics
+local utils = chess.fics.utils
+local reactor = chess.fics.reactor.reactor
+
+-- The end of a socket pair with the methods of a LuaSocket tcp object the
+-- clients use, the buffer stands for data LuaSocket has read already.
+local sock = {}
+
+function sock:new(fd)
+    return setmetatable({fd = fd, buffer = ""}, {__index = sock})
+end
+function sock:getfd() return self.fd end
+function sock:settimeout() end
+function sock:setoption() end
+function sock:dirty() return self.buffer ~= "" end
+function sock:send(data) return sockpair.write(self.fd, data) end
+function sock:close() sockpair.close(self.fd) end
+function sock:receive(size)
+    local data, errmsg = self.buffer, nil
+    self.buffer = ""
+    while #data < size do
+        local chunk
+        chunk, errmsg = sockpair.read(self.fd, size - #data)
+        if chunk == nil then break end
+        data = data .. chunk
+    end
+    if errmsg ~= nil then return nil, errmsg, data end
+    return data
+end
+
+-- Returns a client connected to the returned server end.
+local function connect()
+    local a, b = assert(sockpair.open())
+    local client = fics.client:new{}
+    client.sock = sock:new(a)
+    return client, sock:new(b)
+end
+
+TestReactor = {} -- class
+    function TestReactor:test_01_poll()
+        local a, b = assert(sockpair.open())
+        local ready = assert(utils.poll({a, b}, 0))
+        assert(#ready == 0)
+        sockpair.write(a, "foo")
+        ready = assert(utils.poll({a, b}, 1))
+        assert(#ready == 1 and ready[1] == 2)
+        assert(sockpair.read(b) == "foo")
+        sockpair.close(a)
+        ready = assert(utils.poll({b}, 1))
+        assert(#ready == 1)
+        local data, errmsg = sockpair.read(b)
+        assert(data == nil and errmsg == "closed")
+        sockpair.close(b)
+        assert(#assert(utils.poll({}, 0)) == 0)
+    end
+    function TestReactor:test_02_round_trip()
+        local r = reactor:new{idle_interval = 60}
+        local c1, s1 = connect()
+        local c2, s2 = connect()
+        local seen = {}
+        for _, c in ipairs{c1, c2} do
+            c:register_callback("line", function (client, group, line)
+                table.insert(seen, {client, line})
+            end)
+            r:add(c)
+        end
+
+        -- Lines are parsed as they arrive, partial ones wait for the rest.
+        s2:send("foo\n\rba")
+        assert(r:step(1))
+        assert(#seen == 1 and seen[1][1] == c2 and seen[1][2] == "foo")
+        s1:send("fics% ")
+        s2:send("r\n\r")
+        assert(r:step(1))
+        assert(r:step(0))
+        assert(#seen == 3)
+
+        -- Clients answer over the same sockets.
+        assert(c1:send("tell bar"))
+        assert(s1:receive(9) == "tell bar\n")
+
+        -- Data buffered by the socket is dispatched without waiting.
+        c1.sock.buffer = "buffered\n\r"
+        assert(r:step(60))
+        assert(seen[4][1] == c1 and seen[4][2] == "buffered")
+    end
+    function TestReactor:test_03_disconnect()
+        local r = reactor:new{idle_interval = 60}
+        local c1, s1 = connect()
+        local c2, s2 = connect()
+        local gone
+        c1:register_callback("disconnect", function (client, errmsg)
+            gone = errmsg
+        end)
+        r:add(c1)
+        r:add(c2)
+
+        -- A closed server end removes the client.
+        s1:close()
+        assert(r:step(1))
+        assert(gone == "closed")
+        assert(#r.clients == 1 and r.clients[1] == c2)
+        assert(c1.sock == nil)
+
+        -- Clients disconnected elsewhere are dropped.
+        c2:disconnect()
+        assert(r:step(0))
+        assert(#r.clients == 0)
+        assert(r:loop())
+        s2:close()
+    end
+    function TestReactor:test_04_idle_error()
+        local r = reactor:new{idle_interval = 60}
+        local c1, s1 = connect()
+        local c2, s2 = connect()
+        local gone, idle
+        c1:register_callback("idle", function (client) error "boom" end)
+        c1:register_callback("disconnect", function (client, errmsg)
+            gone = errmsg
+            error "again"
+        end)
+        c2:register_callback("idle", function (client) idle = true end)
+        r:add(c1)
+        r:add(c2)
+
+        -- A failing idle callback removes its client only.
+        assert(r:step(0))
+        assert(gone:find("boom"), gone)
+        assert(idle)
+        assert(#r.clients == 1 and r.clients[1] == c2)
+        assert(c1.sock == nil)
+        c2:disconnect()
+        s1:close()
+        s2:close()
+    end
+-- class
+
+ret = LuaUnit:run()
+if ret > 0 then os.exit(1) end
@@ -0,0 +1,74 @@
+#!/usr/bin/env lua
+-- vim: set et sts=4 sw=4 ts=4 tw=80 fdm=marker:
+--[[
+  Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+
+  This file is part of LuaChess. LuaChess is free software; you can redistribute
+  it and/or modify it under the terms of the GNU General Public License version
+  2, as published by the Free Software Foundation.
+
+  LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+  A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+  Place, Suite 330, Boston, MA  02111-1307  USA
+--]]
+
+-- Unit tests for chess.icc.utils
+-- Requires luaunit.
+
+require "luaunit"
+require "customloaders"
+
+-- The clients are never connected, LuaSocket isn't needed.
+if not pcall(require, "socket") then package.loaded.socket = {} end
+require "chess.icc"
+local clienttest = require "clienttest"
+
+local icc = chess.icc
+local utils = chess.icc.utils
+local same = clienttest.same
+
+-- EOR is the octal 031 of the C module.
+local E = icc.EOR
+local stream = "login: \r\nGuestABCD logged in.\r\n" ..
+    E .. "(0 GuestABCD " .. E .. "(28 foo" .. E .. ")\r\nbar" .. E .. ")\r\n" ..
+    "password: aics% tell me\r\n" .. E .. "(1 x" .. E .. ")"
+local expected = {"login: ", "", "GuestABCD logged in.",
+    E .. "(0 GuestABCD " .. E .. "(28 foo" .. E .. ")bar" .. E .. ")", "",
+    "password: ", "aics% tell me", E .. "(1 x" .. E .. ")"}
+
+TestIcc = {} -- class
+    function TestIcc:test_01_datagrams()
+        local lines, rest = utils.datagrams(stream)
+        assert(same(lines, expected))
+        assert(rest == "")
+
+        -- Incomplete lines and datagrams are returned as the rest.
+        lines, rest = utils.datagrams("aics% foo\r\nbar")
+        assert(same(lines, {"aics% foo"}))
+        assert(rest == "bar")
+        lines, rest = utils.datagrams(E .. "(0 a" .. E .. "(1 b" .. E .. ")\r\n")
+        assert(#lines == 0 and rest == E .. "(0 a" .. E .. "(1 b" .. E .. ")\r\n")
+        lines, rest = utils.datagrams("logi")
+        assert(#lines == 0 and rest == "logi")
+
+        -- A delimiter split after its EOR waits for the second byte.
+        lines, rest = utils.datagrams("foo" .. E)
+        assert(#lines == 0 and rest == "foo" .. E)
+        lines, rest = utils.datagrams(E .. "(0 a" .. E)
+        assert(#lines == 0 and rest == E .. "(0 a" .. E)
+        lines, rest = utils.datagrams(rest .. ")")
+        assert(same(lines, {E .. "(0 a" .. E .. ")"}) and rest == "")
+    end
+    function TestIcc:test_02_feed_every_boundary()
+        -- Splitting the data anywhere gives the same lines.
+        clienttest.feed_every_boundary(function () return icc.client:new{} end,
+            stream, expected)
+    end
+-- class
+
+ret = LuaUnit:run()
+if ret > 0 then os.exit(1) end
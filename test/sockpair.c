@@ -0,0 +1,121 @@
+/* Socket pairs for the tests of LuaChess.
+ * vim: set et ts=4 sts=4 sw=4 fdm=syntax :
+ *
+ * Copyright (c) 2009 Ali Polatel <polatel@gmail.com>
+ *
+ * This file is part of LuaChess. LuaChess is free software; you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation.
+
+ * LuaChess is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* The clients are tested over local socket pairs instead of connections to
+ * the servers, the descriptors are wrapped like LuaSocket's by the tests.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+
+#define READ_MAX 8192
+
+LUALIB_API int luaopen_sockpair(lua_State *L);
+
+/* sockpair.open() returns the two non-blocking descriptors of a socket pair
+ * or nil and an error message.
+ */
+static int sockpair_open(lua_State *L) {
+    int i, fds[2];
+
+    if (-1 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+    for (i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        lua_pushinteger(L, fds[i]);
+    }
+    return 2;
+}
+
+/* sockpair.write(fd, data) returns the number of bytes written or nil and an
+ * error message.
+ */
+static int sockpair_write(lua_State *L) {
+    int fd;
+    size_t len;
+    ssize_t n;
+    const char *data;
+
+    fd = luaL_checkinteger(L, 1);
+    data = luaL_checklstring(L, 2, &len);
+
+    if (-1 == (n = write(fd, data, len))) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+/* sockpair.read(fd, size) returns at most size bytes, nil and "timeout" if
+ * there's nothing to read and nil and "closed" if the other end is closed.
+ */
+static int sockpair_read(lua_State *L) {
+    int fd, size;
+    ssize_t n;
+    char buf[READ_MAX];
+
+    fd = luaL_checkinteger(L, 1);
+    size = luaL_optint(L, 2, READ_MAX);
+    if (size < 1 || size > READ_MAX)
+        size = READ_MAX;
+
+    n = read(fd, buf, size);
+    if (n > 0) {
+        lua_pushlstring(L, buf, n);
+        return 1;
+    }
+    lua_pushnil(L);
+    if (0 == n)
+        lua_pushliteral(L, "closed");
+    else if (EAGAIN == errno)
+        lua_pushliteral(L, "timeout");
+    else
+        lua_pushstring(L, strerror(errno));
+    return 2;
+}
+
+/* sockpair.close(fd) closes the descriptor. */
+static int sockpair_close(lua_State *L) {
+    close(luaL_checkinteger(L, 1));
+    return 0;
+}
+
+static const luaL_reg sockpair_global[] = {
+    {"open",            sockpair_open},
+    {"write",           sockpair_write},
+    {"read",            sockpair_read},
+    {"close",           sockpair_close},
+    {NULL,              NULL}
+};
+
+LUALIB_API int luaopen_sockpair(lua_State *L) {
+    luaL_register(L, "sockpair", sockpair_global);
+    return 1;
+}